@@ -0,0 +1,165 @@
+//
+// Persistent cache of game scores, shared between processes.
+//
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "EvaluationCache.h"
+
+#define EVALUATION_CACHE_MAGIC   "MDPTCACH"
+#define EVALUATION_CACHE_VERSION 1
+
+EvaluationCache::EvaluationCache(std::string filename, std::size_t nbSlots)
+    : m_filename(filename), m_hits(0), m_misses(0)
+{
+    /* The table size must be a power of two */
+    std::size_t size = 1;
+    while (size < nbSlots)
+    {
+        size <<= 1;
+    }
+    nbSlots = size;
+
+    m_fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd == -1)
+    {
+        std::cerr << "Cannot open the evaluation cache " << filename << std::endl;
+        exit(1);
+    }
+
+    /* Only one process creates the table, the others wait for it */
+    flock(m_fd, LOCK_EX);
+
+    struct stat fileStat;
+    fstat(m_fd, &fileStat);
+
+    Header header;
+    if (fileStat.st_size == 0)
+    {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, EVALUATION_CACHE_MAGIC, sizeof(header.magic));
+        header.version = EVALUATION_CACHE_VERSION;
+        header.slotSize = sizeof(Slot);
+        header.nbSlots = nbSlots;
+
+        /* The file is sparse, free slots cost no disk space */
+        if (ftruncate(m_fd, sizeof(Header) + nbSlots * sizeof(Slot)) != 0
+            || pwrite(m_fd, &header, sizeof(header), 0) != sizeof(header))
+        {
+            std::cerr << "Cannot create the evaluation cache " << filename << std::endl;
+            exit(1);
+        }
+    }
+    else if (pread(m_fd, &header, sizeof(header), 0) != sizeof(header)
+             || std::memcmp(header.magic, EVALUATION_CACHE_MAGIC, sizeof(header.magic)) != 0
+             || header.version != EVALUATION_CACHE_VERSION
+             || header.slotSize != sizeof(Slot)
+             || (header.nbSlots & (header.nbSlots - 1)) != 0
+             || (uint64_t) fileStat.st_size != sizeof(Header) + header.nbSlots * sizeof(Slot))
+    {
+        std::cerr << "Invalid evaluation cache file " << filename << std::endl;
+        exit(1);
+    }
+
+    flock(m_fd, LOCK_UN);
+
+    m_mappedSize = sizeof(Header) + header.nbSlots * sizeof(Slot);
+    m_mapping = mmap(NULL, m_mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_mapping == MAP_FAILED)
+    {
+        std::cerr << "Cannot map the evaluation cache " << filename << std::endl;
+        exit(1);
+    }
+
+    m_slots = reinterpret_cast<Slot *>(static_cast<char *>(m_mapping) + sizeof(Header));
+    m_mask = header.nbSlots - 1;
+}
+
+EvaluationCache::~EvaluationCache()
+{
+    munmap(m_mapping, m_mappedSize);
+    close(m_fd);
+}
+
+bool EvaluationCache::lookup(uint64_t key, uint64_t check, int *score) const
+{
+    /* 0 marks the free slots */
+    if (key == 0)
+    {
+        key = 1;
+    }
+
+    for (std::size_t i = 0; i < MAX_PROBES; i++)
+    {
+        Slot *slot = &m_slots[(key + i) & m_mask];
+        uint64_t slotKey = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+
+        if (slotKey == 0)
+        {
+            break;
+        }
+
+        /* A slot still being written by another process counts as a miss,
+         * check and score are only read once ready is published */
+        if (slotKey == key
+            && __atomic_load_n(&slot->ready, __ATOMIC_ACQUIRE)
+            && __atomic_load_n(&slot->check, __ATOMIC_RELAXED) == check)
+        {
+            *score = __atomic_load_n(&slot->score, __ATOMIC_RELAXED);
+            m_hits++;
+            return true;
+        }
+    }
+
+    m_misses++;
+    return false;
+}
+
+void EvaluationCache::insert(uint64_t key, uint64_t check, int score)
+{
+    if (key == 0)
+    {
+        key = 1;
+    }
+
+    for (std::size_t i = 0; i < MAX_PROBES; i++)
+    {
+        Slot *slot = &m_slots[(key + i) & m_mask];
+        uint64_t expected = 0;
+
+        if (__atomic_compare_exchange_n(&slot->key, &expected, key, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            /* The slot is ours: nobody reads check and score before ready */
+            __atomic_store_n(&slot->check, check, __ATOMIC_RELAXED);
+            __atomic_store_n(&slot->score, score, __ATOMIC_RELAXED);
+            __atomic_store_n(&slot->ready, 1, __ATOMIC_RELEASE);
+            return;
+        }
+
+        if (expected == key)
+        {
+            /* Another process claimed this key and has not published it yet:
+             * it is almost surely the same game, so do not store a duplicate
+             * in another slot */
+            if (!__atomic_load_n(&slot->ready, __ATOMIC_ACQUIRE))
+            {
+                return;
+            }
+
+            /* Same game already stored */
+            if (__atomic_load_n(&slot->check, __ATOMIC_RELAXED) == check)
+            {
+                return;
+            }
+        }
+    }
+}
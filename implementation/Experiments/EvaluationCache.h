@@ -0,0 +1,86 @@
+//
+// Persistent cache of game scores, shared between processes.
+//
+
+#ifndef EXAMPLEPROJECT_EVALUATIONCACHE_H
+#define EXAMPLEPROJECT_EVALUATIONCACHE_H
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * Cache of the score of single games, stored in a memory-mapped
+ * file. A game is identified by a 128 bit key built from everything
+ * that determines its outcome (features, pieces, board geometry,
+ * weights and game seed), see MDPTetris::playGames. The games of the
+ * policies with the local value function are not cached, since their
+ * outcome also depends on the values file.
+ *
+ * The file is an open addressing hash table. Slots are claimed with
+ * atomic compare-and-swap of their key directly in the shared mapping,
+ * so several processes on the same machine can read and fill the same
+ * cache concurrently without locking. The claiming process then writes
+ * the check word and the score and publishes them with the ready flag:
+ * the other processes ignore a slot until it is ready, and an insert
+ * that finds its key claimed but not ready gives up rather than storing
+ * the same game twice. When the table is full, new scores are simply
+ * not stored.
+ */
+class EvaluationCache {
+
+public:
+
+    /* Open the cache file, creating it with room for
+     * nbSlots games if it does not exist yet */
+    EvaluationCache(std::string filename, std::size_t nbSlots = (1 << 22));
+    ~EvaluationCache();
+
+    /* Look up the score of a game, returns false if unknown */
+    bool lookup(uint64_t key, uint64_t check, int *score) const;
+
+    /* Store the score of a game */
+    void insert(uint64_t key, uint64_t check, int score);
+
+    /* Number of lookups answered from the cache and missed */
+    std::size_t hits(void) const { return m_hits; }
+    std::size_t misses(void) const { return m_misses; }
+
+private:
+
+    /* One slot of the table, as laid out in the file */
+    struct Slot
+    {
+        uint64_t key;    /* 0 if the slot is free */
+        uint64_t check;  /* second half of the key */
+        int32_t score;
+        uint32_t ready;  /* set once check and score are written */
+    };
+
+    /* Header at the beginning of the file */
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotSize;
+        uint64_t nbSlots;
+    };
+
+    /* Maximum number of slots probed before giving up */
+    static const std::size_t MAX_PROBES = 64;
+
+    std::string m_filename;
+    int m_fd;
+    std::size_t m_mappedSize;
+    void *m_mapping;
+    Slot *m_slots;
+    uint64_t m_mask;
+
+    mutable std::size_t m_hits, m_misses;
+
+    /* Non copyable */
+    EvaluationCache(const EvaluationCache &);
+    EvaluationCache &operator=(const EvaluationCache &);
+};
+
+#endif //EXAMPLEPROJECT_EVALUATIONCACHE_H
@@ -38,10 +38,18 @@
 #include <iostream>
 #include <string>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
 
 #include "cconfig.h"
 #include "MDPTetris.h"
 #include "CrossEntropy.h"
+#include "RunLogger.h"
+#include "RunTrace.h"
+
+extern "C"{
+#include "interruptions.h"
+};
 
 #define OPT_SEED               "-seed"
 #define OPT_START_POL_FILE     "-startPolicy"
@@ -56,6 +64,9 @@
 #define OPT_NB_LEARNING_GAMES  "-nbLearningGames"
 #define OPT_OUTPUTNAME         "-output"
 
+/* Format of the output: csv (default) or binary, see RunTrace.h */
+#define OPT_OUTPUT_FORMAT      "-outputFormat"
+
 /* Options for stopping criteria */
 #define OPT_MAXITER            "-maxiter"
 #define OPT_MAX_AGENTS         "-maxagents"
@@ -75,10 +86,36 @@
 /* CMA-ES recombination type */
 #define OPT_RECOMBINATION_TYPE "-recombinationType"
 
+/* File of the evaluation cache, shared between runs */
+#define OPT_EVALUATION_CACHE   "-evaluationCache"
+
+/* Full board, on which the mean is reported */
+#define OPT_BOARD_WIDTH        "-boardWidth"
+#define OPT_BOARD_HEIGHT       "-boardHeight"
+
+/* Board on which the optimizer samples are evaluated,
+ * the full board by default */
+#define OPT_EVAL_BOARD_WIDTH   "-evalBoardWidth"
+#define OPT_EVAL_BOARD_HEIGHT  "-evalBoardHeight"
+
+/* Number of policies compared by -optimizer=calibrate */
+#define OPT_CALIBRATION_SAMPLES "-calibrationSamples"
+
+/* Number of moves searched with one more piece,
+ * 0 (default) for the one-ply search */
+#define OPT_LOOKAHEAD          "-lookahead"
+
+/* 1 (default) to skip the features of the moves that cannot be
+ * the best one, 0 to compute all of them; the moves are the same */
+#define OPT_LAZY_EVALUATION    "-lazyEvaluation"
+
 const std::string known_opts[]
         = {OPT_SEED,OPT_START_POL_FILE,OPT_PIECE_FILE,OPT_OPTIMIZER,OPT_INITIAL_SIGMA,
            OPT_NB_GAMES,OPT_NB_LEARNING_GAMES,OPT_OUTPUTNAME,OPT_MAXITER,OPT_MAX_AGENTS,
            OPT_NOISETYPE,OPT_NOISE,OPT_NOISE2,OPT_LOWER_BOUND,OPT_LAMBDA,OPT_OFFSPRING,OPT_RECOMBINATION_TYPE,
+           OPT_EVALUATION_CACHE,OPT_OUTPUT_FORMAT,OPT_BOARD_WIDTH,OPT_BOARD_HEIGHT,
+           OPT_EVAL_BOARD_WIDTH,OPT_EVAL_BOARD_HEIGHT,OPT_CALIBRATION_SAMPLES,OPT_LOOKAHEAD,
+           OPT_LAZY_EVALUATION,
            "STOP"};
 
 /* The stopping criteria for the experiment */
@@ -115,12 +152,201 @@ private:
     T    m_value;
 };
 
+/* Engine counters of a generation, as columns of the output: they
+ * follow the summary of the scores (and the step size) and come before
+ * the w* weights and the per-game s* scores */
+void addCountersColumns(std::vector<std::string> &columns)
+{
+    columns.push_back("pieces");
+    columns.push_back("afterstates");
+    columns.push_back("lines");
+    columns.push_back("wallSeconds");
+    columns.push_back("cpuSeconds");
+    columns.push_back("piecesPerSecond");
+}
+
+void addCounters(std::vector<double> &row, const MDPTetris::EvaluationCounters &counters)
+{
+    row.push_back(counters.pieces);
+    row.push_back(counters.afterstates);
+    row.push_back(counters.lines);
+    row.push_back(counters.wallSeconds);
+    row.push_back(counters.cpuSeconds);
+    row.push_back(counters.wallSeconds > 0 ? counters.pieces / counters.wallSeconds : 0.0);
+}
+
+/* Columns named prefix0, prefix1, ... */
+void addNumberedColumns(std::vector<std::string> &columns, std::string prefix, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        std::stringstream s;
+        s << prefix << i;
+        columns.push_back(s.str());
+    }
+}
+
+/* Game with the evaluation geometry, or NULL if it is the full board */
+Game *newEvaluationGame(std::string piecesFile,
+                        unsigned int boardWidth,
+                        unsigned int boardHeight,
+                        unsigned int evalBoardWidth,
+                        unsigned int evalBoardHeight)
+{
+    if (evalBoardWidth == boardWidth && evalBoardHeight == boardHeight)
+    {
+        return NULL;
+    }
+    return new_game(0, evalBoardWidth, evalBoardHeight, 0, piecesFile.c_str(), NULL);
+}
+
+/* Ranks of the values, 0 for the smallest, ties get their mean rank */
+std::vector<double> ranks(const std::vector<double> &values)
+{
+    std::vector<std::size_t> order(values.size());
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [&values](std::size_t a, std::size_t b) { return values[a] < values[b]; });
+
+    std::vector<double> result(values.size());
+    std::size_t i = 0;
+    while (i < order.size())
+    {
+        std::size_t j = i;
+        while (j + 1 < order.size() && values[order[j + 1]] == values[order[i]])
+        {
+            j++;
+        }
+        for (std::size_t k = i; k <= j; k++)
+        {
+            result[order[k]] = 0.5 * (i + j);
+        }
+        i = j + 1;
+    }
+    return result;
+}
+
+/* Spearman rank correlation, i.e. Pearson correlation of the ranks */
+double rankCorrelation(const std::vector<double> &x, const std::vector<double> &y)
+{
+    std::vector<double> rx = ranks(x), ry = ranks(y);
+    std::size_t n = rx.size();
+    double meanX = 0.0, meanY = 0.0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        meanX += rx[i];
+        meanY += ry[i];
+    }
+    meanX /= n;
+    meanY /= n;
+
+    double covariance = 0.0, varianceX = 0.0, varianceY = 0.0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        covariance += (rx[i] - meanX) * (ry[i] - meanY);
+        varianceX += (rx[i] - meanX) * (rx[i] - meanX);
+        varianceY += (ry[i] - meanY) * (ry[i] - meanY);
+    }
+    if (varianceX == 0.0 || varianceY == 0.0)
+    {
+        return 0.0;
+    }
+    return covariance / std::sqrt(varianceX * varianceY);
+}
+
+/* Play policies sampled around the starting policy on both
+ * geometries, and report how well the evaluation board preserves
+ * the ranking of the full board.
+ */
+void calibrateGeometry(std::string startPolicyFile,
+                       std::string piecesFile,
+                       unsigned int nbGames,
+                       unsigned int boardWidth,
+                       unsigned int boardHeight,
+                       unsigned int evalBoardWidth,
+                       unsigned int evalBoardHeight,
+                       unsigned int lookahead,
+                       bool lazyEvaluation,
+                       int randomSeed,
+                       ExperimentOptionType<double> initialSigma,
+                       unsigned int nbSamples,
+                       std::ostream & out)
+{
+    out << "Calibrating the evaluation board with following configurations" << std::endl;
+    out << "Start policy       : " << startPolicyFile << std::endl;
+    out << "Pieces             : " << piecesFile << std::endl;
+    out << "Game evaluations   : " << nbGames << std::endl;
+    out << "Game board         : " << boardWidth << "x" << boardHeight << std::endl;
+    out << "Evaluation board   : " << evalBoardWidth << "x" << evalBoardHeight << std::endl;
+    out << "Lookahead moves    : " << lookahead << std::endl;
+    out << "Lazy evaluation    : " << lazyEvaluation << std::endl;
+    out << "Random seed        : " << randomSeed << std::endl;
+    out << "Sampled policies   : " << nbSamples << std::endl;
+
+    initialize_random_generator( randomSeed );
+
+    Game *game = new_game(0, boardWidth, boardHeight, 0, piecesFile.c_str(), NULL);
+    Game *evalGame = newEvaluationGame(piecesFile, boardWidth, boardHeight, evalBoardWidth, evalBoardHeight);
+    GamesStatistics *stats = games_statistics_new(NULL, nbGames, NULL);
+
+    MDPTetris objFun(boardWidth, boardHeight, nbGames, game, stats, startPolicyFile);
+    objFun.setEvaluationGame(evalGame);
+    objFun.setLookahead(lookahead);
+    objFun.setLazyEvaluation(lazyEvaluation);
+    objFun.setRunSeed(randomSeed);
+
+    /* All the policies play the same piece sequences */
+    objFun.setSeedPerCandidate(false);
+
+    double sigma = initialSigma.used() ? initialSigma() : 1.0;
+    MDPTetris::SearchPointType start = objFun.proposeStartingPoint();
+    std::vector<double> evalScores, fullScores;
+    double evalSeconds = 0.0, fullSeconds = 0.0;
+
+    for (unsigned int i = 0; i < nbSamples; i++)
+    {
+        MDPTetris::SearchPointType point = start;
+        for (std::size_t j = 0; j < point.size(); j++)
+        {
+            point(j) = random_gaussian(start(j), sigma);
+        }
+
+        objFun.resetCounters();
+        evalScores.push_back(TETRIS_MAX_SCORE - objFun.eval(point));
+        evalSeconds += objFun.counters().wallSeconds;
+
+        objFun.resetCounters();
+        fullScores.push_back(objFun.evalDetailed(point).mean());
+        fullSeconds += objFun.counters().wallSeconds;
+
+        out << i << " : " << evalScores.back() << " / " << fullScores.back() << std::endl;
+    }
+
+    out << "Evaluation board   : " << evalSeconds << " s" << std::endl;
+    out << "Game board         : " << fullSeconds << " s" << std::endl;
+    out << "Rank correlation   : " << rankCorrelation(evalScores, fullScores) << std::endl;
+
+    games_statistics_free(stats);
+    if (evalGame != NULL)
+    {
+        free_game(evalGame);
+    }
+    free_game(game);
+}
+
 void useCMA(std::string startPolicyFile,
             std::string piecesFile,
             unsigned int nbGames,
             unsigned int nbLearnGames,
             unsigned int boardWidth,
             unsigned int boardHeight,
+            unsigned int evalBoardWidth,
+            unsigned int evalBoardHeight,
+            unsigned int lookahead,
+            bool lazyEvaluation,
             int randomSeed,
             ExperimentOptionType<double> initialSigma,
             unsigned int maxIterations,
@@ -128,10 +354,12 @@ void useCMA(std::string startPolicyFile,
             StoppingCriteria stoppingCriteria,
             std::ostream & out,
             std::string outname,
+            bool binaryOutput,
             ExperimentOptionType<double> lowerBound,
             ExperimentOptionType<unsigned int> lambda,
             ExperimentOptionType<unsigned int> offspring,
-            ExperimentOptionType<shark::CMA::RecombinationType> recombinationType)
+            ExperimentOptionType<shark::CMA::RecombinationType> recombinationType,
+            ExperimentOptionType<std::string> evaluationCache)
 {
     out << "Running CMA-ES with following configurations" << std::endl;
     out << "Start policy       : " << startPolicyFile << std::endl;
@@ -140,6 +368,9 @@ void useCMA(std::string startPolicyFile,
     out << "Game learning games: " << nbLearnGames << std::endl;
     out << "Game board with    : " << boardWidth << std::endl;
     out << "Game board height  : " << boardHeight << std::endl;
+    out << "Evaluation board   : " << evalBoardWidth << "x" << evalBoardHeight << std::endl;
+    out << "Lookahead moves    : " << lookahead << std::endl;
+    out << "Lazy evaluation    : " << lazyEvaluation << std::endl;
     out << "Random seed        : " << randomSeed << std::endl;
     if (initialSigma.used())
         out << "initialSigma       : " << initialSigma() << std::endl;
@@ -151,13 +382,22 @@ void useCMA(std::string startPolicyFile,
     shark::Rng::seed( randomSeed );
     shark::CMA cma;
 
-    Game *game = new_game(0, 10, 20, 0, piecesFile.c_str(), NULL);
+    Game *game = new_game(0, boardWidth, boardHeight, 0, piecesFile.c_str(), NULL);
+    Game *evalGame = newEvaluationGame(piecesFile, boardWidth, boardHeight, evalBoardWidth, evalBoardHeight);
     GamesStatistics *stats = games_statistics_new(NULL, 10, NULL);
 
-    MDPTetris objFun(10,20, nbGames, game, stats, startPolicyFile);
-    if ( outname.size() > 0 )
+    MDPTetris objFun(boardWidth, boardHeight, nbGames, game, stats, startPolicyFile);
+    objFun.setEvaluationGame(evalGame);
+    objFun.setLookahead(lookahead);
+    objFun.setLazyEvaluation(lazyEvaluation);
+    objFun.setRunSeed(randomSeed);
+
+    /* Reuse the scores of games already played, in this run or others */
+    EvaluationCache *cache = NULL;
+    if (evaluationCache.used())
     {
-        objFun.setGamedataFilename(outname);
+        cache = new EvaluationCache(evaluationCache());
+        objFun.setEvaluationCache(cache);
     }
 
     // If population size and offspring is given, special initialization needs to take place.
@@ -213,40 +453,43 @@ void useCMA(std::string startPolicyFile,
 
     bool running = true;
 
-    /* Report header for CSV output */
+    /* The output stays open for the whole run */
+    RunLogger logger;
+    RunTraceWriter *output = NULL;
+
+    /* Report header for the output */
     if ( outname.size() > 0 )
     {
-        /* Write the header */
-        std::ofstream fs;
-        fs.open (outname.c_str());
-
-        fs << "generation,agents,minScore,maxScore,meanScore,standardDeviation,stepSize,";
-        for (int i = 0; i < objFun.numberOfVariables(); i++)
-        {
-            fs << "w" << i << ",";
-        }
-
-        for (int i = 0; i < nbLearnGames; i++)
-        {
-            fs << "s" << i << ",";
-        }
-
-        for (int i = 0; i < objFun.numberOfVariables()-1; i++)
-        {
-            fs << "e" << i << ",";
-        }
-        fs << "e" <<  objFun.numberOfVariables()-1 << std::endl;
-
-        fs.close();
+        std::vector<std::string> columns;
+        columns.push_back("generation");
+        columns.push_back("agents");
+        columns.push_back("minScore");
+        columns.push_back("maxScore");
+        columns.push_back("meanScore");
+        columns.push_back("standardDeviation");
+        columns.push_back("stepSize");
+        addCountersColumns(columns);
+        addNumberedColumns(columns, "w", objFun.numberOfVariables());
+        addNumberedColumns(columns, "s", nbLearnGames);
+        addNumberedColumns(columns, "e", objFun.numberOfVariables());
+
+        output = new RunTraceWriter(logger, outname, binaryOutput, columns);
     }
 
+    /* Ctrl-C stops the run at the end of the current generation */
+    initialize_interruptions();
 
     while (running)
     {
 
+        objFun.setGeneration(generation);
+        objFun.resetCounters();
         cma.step(objFun);
         t += cma.lambda() * nbGames;
 
+        /* Work done by the optimizer in this generation */
+        MDPTetris::EvaluationCounters counters = objFun.counters();
+
         if ( outname.size() > 0 )
         {
 
@@ -258,27 +501,26 @@ void useCMA(std::string startPolicyFile,
             double centroid_score = report.mean();
             _DUMP(centroid_score);
 
-            // Get a string of eignvalues
-            std::stringstream _s;
-            for (int i = 0; i < cma.eigenValues().size()-1; i++)
+            std::vector<double> row;
+            row.push_back(generation);
+            row.push_back(t);
+            row.push_back(report.minScore());
+            row.push_back(report.maxScore());
+            row.push_back(report.mean());
+            row.push_back(report.standardDeviation());
+            row.push_back(cma.sigma());
+            addCounters(row, counters);
+            std::vector<double> weights = report.weights();
+            row.insert(row.end(), weights.begin(), weights.end());
+            std::vector<unsigned int> scores = report.scores();
+            row.insert(row.end(), scores.begin(), scores.end());
+            for (int i = 0; i < cma.eigenValues().size(); i++)
             {
-                _s << cma.eigenValues()[i] << ",";
+                row.push_back(cma.eigenValues()[i]);
             }
-            _s << cma.eigenValues()[cma.eigenValues().size()-1];
-
-            std::ofstream fs;
-            fs.open (outname.c_str(), std::ios::app);
-            fs << generation << ","
-               << t << ","
-               << report.minScore() << ","
-               << report.maxScore() << ","
-               << report.mean() << ","
-               << report.standardDeviation() << ","
-               << cma.sigma()  << ","
-               << report.printWeights(",") << ","
-               << report.printScores(",") << ","
-               << _s.str()
-                  << std::endl;
+
+            output->write(row);
+            logger.flush();
         }
 
         if (TETRIS_MAX_SCORE - cma.solution().value > bestScore)
@@ -298,8 +540,22 @@ void useCMA(std::string startPolicyFile,
         {
             running = false;
         }
+        else if (is_interrupted())
+        {
+            running = false;
+        }
     }
 
+    exit_interruptions();
+    delete output;
+
+    if (cache != NULL)
+    {
+        out << "Cache hits         : " << cache->hits() << std::endl;
+        out << "Cache misses       : " << cache->misses() << std::endl;
+        objFun.setEvaluationCache(NULL);
+        delete cache;
+    }
 
 }
 
@@ -310,6 +566,10 @@ void useCE(std::string startPolicyFile,
            unsigned int nbLearnGames,
            unsigned int boardWidth,
            unsigned int boardHeight,
+           unsigned int evalBoardWidth,
+           unsigned int evalBoardHeight,
+           unsigned int lookahead,
+           bool lazyEvaluation,
            int randomSeed,
            ExperimentOptionType<double> initialVariance,
            unsigned int maxIterations,
@@ -317,9 +577,11 @@ void useCE(std::string startPolicyFile,
            StoppingCriteria stoppingCriteria,
            std::ostream & out,
            std::string outname,
+           bool binaryOutput,
            ExperimentOptionType<shark::CrossEntropy::INoiseType*> noise,
            ExperimentOptionType<unsigned int> lambda,
-           ExperimentOptionType<unsigned int> offspring
+           ExperimentOptionType<unsigned int> offspring,
+           ExperimentOptionType<std::string> evaluationCache
 )
 {
     out << "Running Cross Entropy with following configurations" << std::endl;
@@ -329,6 +591,9 @@ void useCE(std::string startPolicyFile,
     out << "Game learning games: " << nbLearnGames << std::endl;
     out << "Game board with    : " << boardWidth << std::endl;
     out << "Game board height  : " << boardHeight << std::endl;
+    out << "Evaluation board   : " << evalBoardWidth << "x" << evalBoardHeight << std::endl;
+    out << "Lookahead moves    : " << lookahead << std::endl;
+    out << "Lazy evaluation    : " << lazyEvaluation << std::endl;
     out << "Random seed        : " << randomSeed << std::endl;
     if (initialVariance.used())
         out << "initialVariance: " << initialVariance() << std::endl;
@@ -338,13 +603,22 @@ void useCE(std::string startPolicyFile,
     shark::Rng::seed( randomSeed );
     shark::CrossEntropy ce;
 
-    Game *game = new_game(0, 10, 20, 0, piecesFile.c_str(), NULL);
+    Game *game = new_game(0, boardWidth, boardHeight, 0, piecesFile.c_str(), NULL);
+    Game *evalGame = newEvaluationGame(piecesFile, boardWidth, boardHeight, evalBoardWidth, evalBoardHeight);
     GamesStatistics *stats = games_statistics_new(NULL, nbGames, NULL);
 
-    MDPTetris objFun(10,20, nbGames, game, stats, startPolicyFile);
-    if ( outname.size() > 0 )
+    MDPTetris objFun(boardWidth, boardHeight, nbGames, game, stats, startPolicyFile);
+    objFun.setEvaluationGame(evalGame);
+    objFun.setLookahead(lookahead);
+    objFun.setLazyEvaluation(lazyEvaluation);
+    objFun.setRunSeed(randomSeed);
+
+    /* Reuse the scores of games already played, in this run or others */
+    EvaluationCache *cache = NULL;
+    if (evaluationCache.used())
     {
-        objFun.setGamedataFilename(outname);
+        cache = new EvaluationCache(evaluationCache());
+        objFun.setEvaluationCache(cache);
     }
 
 
@@ -389,34 +663,41 @@ void useCE(std::string startPolicyFile,
     bool running = true;
 
 
-    /* Report header for CSV output */
+    /* The output stays open for the whole run */
+    RunLogger logger;
+    RunTraceWriter *output = NULL;
+
+    /* Report header for the output */
     if ( outname.size() > 0 )
     {
-        /* Write the header */
-        std::ofstream fs;
-        fs.open (outname.c_str());
-
-        fs << "generation,agents,minScore,maxScore,meanScore,standardDeviation,";
-        for (int i = 0; i < objFun.numberOfVariables(); i++)
-        {
-            fs << "w" << i << ",";
-        }
-
-        for (int i = 0; i < nbLearnGames-1; i++)
-        {
-            fs << "s" << i << ",";
-        }
-        fs << "s" << nbLearnGames-1 << std::endl;
-
-        fs.close();
+        std::vector<std::string> columns;
+        columns.push_back("generation");
+        columns.push_back("agents");
+        columns.push_back("minScore");
+        columns.push_back("maxScore");
+        columns.push_back("meanScore");
+        columns.push_back("standardDeviation");
+        addCountersColumns(columns);
+        addNumberedColumns(columns, "w", objFun.numberOfVariables());
+        addNumberedColumns(columns, "s", nbLearnGames);
+
+        output = new RunTraceWriter(logger, outname, binaryOutput, columns);
     }
 
+    /* Ctrl-C stops the run at the end of the current generation */
+    initialize_interruptions();
+
     while (running)
     {
         _DUMP(generation);
+        objFun.setGeneration(generation);
+        objFun.resetCounters();
         ce.step(objFun);
         t += ce.populationSize() * nbGames;
 
+        /* Work done by the optimizer in this generation */
+        MDPTetris::EvaluationCounters counters = objFun.counters();
+
         if ( outname.size() > 0 )
         {
 
@@ -429,17 +710,21 @@ void useCE(std::string startPolicyFile,
             _DUMP(centroid_score);
 
 
-            std::ofstream fs;
-            fs.open (outname.c_str(), std::ios::app);
-            fs << generation << ","
-            << t << ","
-            << report.minScore() << ","
-            << report.maxScore() << ","
-            << report.mean() << ","
-            << report.standardDeviation() << ","
-            << report.printWeights(",")  << ","
-            << report.printScores(",")
-            << std::endl;
+            std::vector<double> row;
+            row.push_back(generation);
+            row.push_back(t);
+            row.push_back(report.minScore());
+            row.push_back(report.maxScore());
+            row.push_back(report.mean());
+            row.push_back(report.standardDeviation());
+            addCounters(row, counters);
+            std::vector<double> weights = report.weights();
+            row.insert(row.end(), weights.begin(), weights.end());
+            std::vector<unsigned int> scores = report.scores();
+            row.insert(row.end(), scores.begin(), scores.end());
+
+            output->write(row);
+            logger.flush();
         }
 
         if (TETRIS_MAX_SCORE - ce.solution().value > bestScore)
@@ -459,8 +744,22 @@ void useCE(std::string startPolicyFile,
         {
             running = false;
         }
+        else if (is_interrupted())
+        {
+            running = false;
+        }
     }
 
+    exit_interruptions();
+    delete output;
+
+    if (cache != NULL)
+    {
+        out << "Cache hits         : " << cache->hits() << std::endl;
+        out << "Cache misses       : " << cache->misses() << std::endl;
+        objFun.setEvaluationCache(NULL);
+        delete cache;
+    }
 
 }
 
@@ -676,6 +975,45 @@ int main( int argc, char ** argv )
 
     unsigned int boardWidth = 10;
     unsigned int boardHeight = 20;
+    if (options.count(OPT_BOARD_WIDTH) == 1)
+    {
+        boardWidth = atoi ( options[OPT_BOARD_WIDTH].c_str() );
+    }
+    if (options.count(OPT_BOARD_HEIGHT) == 1)
+    {
+        boardHeight = atoi ( options[OPT_BOARD_HEIGHT].c_str() );
+    }
+
+    /* As in the C cross entropy, the samples can be evaluated on a
+     * lower board, where the games are much shorter */
+    unsigned int evalBoardWidth = boardWidth;
+    unsigned int evalBoardHeight = boardHeight;
+    if (options.count(OPT_EVAL_BOARD_WIDTH) == 1)
+    {
+        evalBoardWidth = atoi ( options[OPT_EVAL_BOARD_WIDTH].c_str() );
+    }
+    if (options.count(OPT_EVAL_BOARD_HEIGHT) == 1)
+    {
+        evalBoardHeight = atoi ( options[OPT_EVAL_BOARD_HEIGHT].c_str() );
+    }
+
+    unsigned int lookahead = 0;
+    if (options.count(OPT_LOOKAHEAD) == 1)
+    {
+        lookahead = atoi ( options[OPT_LOOKAHEAD].c_str() );
+    }
+
+    bool lazyEvaluation = true;
+    if (options.count(OPT_LAZY_EVALUATION) == 1)
+    {
+        lazyEvaluation = atoi ( options[OPT_LAZY_EVALUATION].c_str() ) != 0;
+    }
+
+    unsigned int nbCalibrationSamples = 50;
+    if (options.count(OPT_CALIBRATION_SAMPLES) == 1)
+    {
+        nbCalibrationSamples = atoi ( options[OPT_CALIBRATION_SAMPLES].c_str() );
+    }
 
     StoppingCriteria stoppingCriteria = STOP_BY_ITERATION;
     unsigned int maxIterations = 80;  /* Default stop at 80 iterations */
@@ -691,10 +1029,31 @@ int main( int argc, char ** argv )
         stoppingCriteria = STOP_BY_AGENTS_EVALUATED;
     }
 
+    ExperimentOptionType<std::string> evaluationCache(false, "");
+    if (options.count(OPT_EVALUATION_CACHE) == 1)
+    {
+        evaluationCache = ExperimentOptionType<std::string>(true, options[OPT_EVALUATION_CACHE]);
+    }
+
+    /* Binary traces are converted back to CSV with TraceToCsv */
+    bool binaryOutput = false;
+    if (options.count(OPT_OUTPUT_FORMAT) == 1)
+    {
+        if (options[OPT_OUTPUT_FORMAT].compare("binary") == 0)
+        {
+            binaryOutput = true;
+        }
+        else if (options[OPT_OUTPUT_FORMAT].compare("csv") != 0)
+        {
+            std::cerr << "Output format not recognized" << std::endl;
+            return 64;
+        }
+    }
+
     std::string outputfile = std::string("");
     if (options.count(OPT_OUTPUTNAME) == 1)
     {
-        outputfile = std::string(options[OPT_OUTPUTNAME]) + ".txt";
+        outputfile = std::string(options[OPT_OUTPUTNAME]) + (binaryOutput ? ".trace" : ".txt");
     }
 
     if ( options.count(OPT_OPTIMIZER) == 1 )
@@ -708,6 +1067,10 @@ int main( int argc, char ** argv )
                     nbLearnGames,
                     boardWidth,
                     boardHeight,
+                    evalBoardWidth,
+                    evalBoardHeight,
+                    lookahead,
+                    lazyEvaluation,
                     seed,
                     initialSigma,
                     maxIterations,
@@ -715,10 +1078,12 @@ int main( int argc, char ** argv )
                     stoppingCriteria,
                     std::cout,
                     outputfile,
+                    binaryOutput,
                     lowerBound,
                     lambda,
                     offspring,
-                    recombinationType
+                    recombinationType,
+                    evaluationCache
             );
         }
         else if ( options[OPT_OPTIMIZER].compare("ce") == 0 )
@@ -730,6 +1095,10 @@ int main( int argc, char ** argv )
                     nbLearnGames,
                     boardWidth,
                     boardHeight,
+                    evalBoardWidth,
+                    evalBoardHeight,
+                    lookahead,
+                    lazyEvaluation,
                     seed,
                     initialSigma,
                     maxIterations,
@@ -737,9 +1106,29 @@ int main( int argc, char ** argv )
                     stoppingCriteria,
                     std::cout,
                     outputfile,
+                    binaryOutput,
                     noise,
                     lambda,
-                    offspring
+                    offspring,
+                    evaluationCache
+            );
+        }
+        else if ( options[OPT_OPTIMIZER].compare("calibrate") == 0 )
+        {
+            calibrateGeometry(
+                    start_policy,
+                    piece_file,
+                    nbGames,
+                    boardWidth,
+                    boardHeight,
+                    evalBoardWidth,
+                    evalBoardHeight,
+                    lookahead,
+                    lazyEvaluation,
+                    seed,
+                    initialSigma,
+                    nbCalibrationSamples,
+                    std::cout
             );
         }
     }
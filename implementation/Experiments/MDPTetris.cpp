@@ -2,6 +2,11 @@
 // Created by jens on 10/22/15.
 //
 
+#include <cstring>
+#include <chrono>
+#include <stdint.h>
+#include <time.h>
+
 #include "MDPTetris.h"
 
 MDPTetris::MDPTetris(int board_width, int board_height, int nb_games,
@@ -11,6 +16,11 @@ MDPTetris::MDPTetris(int board_width, int board_height, int nb_games,
     load_feature_policy(feature_file.c_str(), &m_featurePolicy);
     features_initialize(&m_featurePolicy);
 
+    /* Skip the features of the moves that cannot be the best one,
+     * the moves chosen are the same, see setLazyEvaluation
+     */
+    m_featurePolicy.lazy_evaluation = 1;
+
     /* Store the location of the piece file */
     //m_pieceFile = piece_file;
 
@@ -29,6 +39,7 @@ MDPTetris::MDPTetris(int board_width, int board_height, int nb_games,
     m_features |= CAN_PROPOSE_STARTING_POINT;
 
     m_game = game;
+    m_evalGame = game;
     m_stats = stats;
 
 }
@@ -56,6 +67,145 @@ std::size_t MDPTetris::numberOfVariables() const {
     return m_dimensions;
 }
 
+unsigned long MDPTetris::candidateSeed(const SearchPointType &input) const {
+
+    unsigned long seed = random_derive_seed(m_runSeed, m_generation);
+    if (!m_seedPerCandidate)
+    {
+        return seed;
+    }
+
+    /* Hash the bit pattern of each weight into the seed */
+    for (std::size_t i = 0; i < input.size(); i++)
+    {
+        double weight = input(i);
+        uint64_t bits;
+        std::memcpy(&bits, &weight, sizeof(bits));
+        seed = random_derive_seed(seed, bits);
+    }
+    return seed;
+}
+
+std::vector<uint64_t> MDPTetris::cacheKeyWords(const FeaturePolicy &policy, const Game *game) const {
+
+    std::vector<uint64_t> words;
+
+    /* Features and decision settings */
+    words.push_back(policy.nb_features);
+    for (int i = 0; i < policy.nb_features; i++)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &policy.features[i].weight, sizeof(bits));
+        words.push_back((uint64_t) (int64_t) policy.features[i].feature_id);
+        words.push_back(bits);
+    }
+    words.push_back(policy.reward_description.reward_function_id);
+    words.push_back((uint64_t) (int64_t) policy.gameover_evaluation);
+    if (policy.lookahead_candidates > 0)
+    {
+        /* Only with the search, so that the keys of the one-ply games do not change */
+        words.push_back(policy.lookahead_candidates);
+    }
+
+    /* Board geometry and rules */
+    words.push_back(game->tetris_implementation);
+    words.push_back(game->board->width);
+    words.push_back(game->board->height);
+    words.push_back(game->board->allow_lines_after_overflow);
+
+    /* Shapes of the pieces */
+    PieceConfiguration *pieces = game->piece_configuration;
+    words.push_back(pieces->nb_pieces);
+    for (int i = 0; i < pieces->nb_pieces; i++)
+    {
+        Piece *piece = &pieces->pieces[i];
+        words.push_back(piece->nb_orientations);
+        for (int j = 0; j < piece->nb_orientations; j++)
+        {
+            PieceOrientation *orientation = &piece->orientations[j];
+            words.push_back(orientation->height);
+            for (int k = 0; k < orientation->height; k++)
+            {
+                words.push_back(orientation->bricks[k]);
+            }
+        }
+    }
+
+    return words;
+}
+
+/* CPU time used by the calling thread, in seconds */
+static double threadCpuSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+double MDPTetris::playGames(const FeaturePolicy &policy, Game *game, unsigned long seed, GamesStatistics *stats) const {
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    double cpuStart = threadCpuSeconds();
+    game_reset_counters(game);
+
+    /* The scores of a policy with the local value function also depend on
+     * the values file loaded, which the key does not identify: they are
+     * never cached, so that a new file is not ignored
+     */
+    EvaluationCache *cache = m_cache;
+    if (contains_feature(&policy, NEXT_LOCAL_VALUE_FUNCTION))
+    {
+        cache = NULL;
+    }
+
+    /* The key of a game is two independent 64 bit
+     * hashes of the policy words and the game seed
+     */
+    uint64_t policyKey = 0, policyCheck = ~0ULL;
+    if (cache != NULL)
+    {
+        std::vector<uint64_t> words = cacheKeyWords(policy, game);
+        for (std::size_t i = 0; i < words.size(); i++)
+        {
+            policyKey = random_derive_seed(policyKey, words[i]);
+            policyCheck = random_derive_seed(policyCheck, words[i]);
+        }
+    }
+
+    for (int i = 0; i < m_nbGames; i++)
+    {
+        /* Each game has its own stream of pieces */
+        unsigned long gameSeed = random_derive_seed(seed, i);
+        int score;
+
+        uint64_t key = random_derive_seed(policyKey, gameSeed);
+        uint64_t check = random_derive_seed(policyCheck, gameSeed);
+        if (cache == NULL || !cache->lookup(key, check, &score))
+        {
+            game_set_seed(game, gameSeed);
+            feature_policy_play_game(&policy, game);
+            score = game->score;
+
+            if (cache != NULL)
+            {
+                cache->insert(key, check, score);
+            }
+        }
+
+        games_statistics_add_game(stats, score);
+    }
+
+    m_counters.evaluations++;
+    m_counters.games += m_nbGames;
+    m_counters.pieces += game->counters.nb_pieces;
+    m_counters.afterstates += game->counters.nb_afterstates;
+    m_counters.lines += game->counters.nb_lines;
+    m_counters.wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    m_counters.cpuSeconds += threadCpuSeconds() - cpuStart;
+
+    return stats->mean;
+}
+
 double MDPTetris::eval(const SearchPointType &input) const {
 
     m_evaluationCounter++;
@@ -78,22 +228,13 @@ double MDPTetris::eval(const SearchPointType &input) const {
     double points;
     GamesStatistics *stats = games_statistics_new(NULL, m_nbGames, NULL);
 
-     /* MDPTetris function for playing tetris:
-        attemptPolicy: policy to use when playing.
-        m_nbGames    : How many games to play.
-        m_game       : The game object, holding board dimensions etc.
-        stats        : The object to hold game statistics.
+     /* Play the games of this candidate:
+        attemptPolicy  : policy to use when playing.
+        m_evalGame     : game with the evaluation geometry.
+        candidateSeed  : seed from which each game's seed is derived.
+        stats          : The object to hold game statistics.
       */
-    points = feature_policy_play_games(&attemptPolicy, m_nbGames, m_game, stats, 0);
-
-    /* Store the results about the game */
-    if (m_gamedataFilename.size() > 0)
-    {
-        std::ofstream fs;
-        fs.open (m_gamedataFilename.c_str(), std::ios::app);
-        fs.close();
-    }
-
+    points = playGames(attemptPolicy, m_evalGame, candidateSeed(input), stats);
 
     games_statistics_end_episode(stats, NULL);
     games_statistics_free(stats);
@@ -146,20 +287,13 @@ MDPTetris::MDPTetrisDetailedResult MDPTetris::evalDetailed(const shark::blas::ve
     double points;
     GamesStatistics *stats = games_statistics_new(NULL, m_nbGames, NULL);
 
-    /* MDPTetris function for playing tetris:
-       attemptPolicy: policy to use when playing.
-       m_nbGames    : How many games to play.
-       m_game       : The game object, holding board dimensions etc.
-       stats        : The object to hold game statistics.
+    /* Play the games of this candidate:
+       attemptPolicy  : policy to use when playing.
+       m_game         : game with the full geometry.
+       candidateSeed  : seed from which each game's seed is derived.
+       stats          : The object to hold game statistics.
      */
-    points = feature_policy_play_games(&attemptPolicy, m_nbGames, m_game, stats, 0);
-
-    /* Store the results about the game */
-    if (m_gamedataFilename.size() > 0)
-    {
-        std::ofstream fs;
-        fs.open (m_gamedataFilename.c_str(), std::ios::app);
-    }
+    points = playGames(attemptPolicy, m_game, candidateSeed(input), stats);
 
     /* Calculate the details of the games played */
     unsigned int minScore, maxScore, sum;
@@ -12,6 +12,8 @@
 
 #include <shark/ObjectiveFunctions/AbstractObjectiveFunction.h>
 
+#include "EvaluationCache.h"
+
 #define TETRIS_MAX_SCORE 1000000.0
 
 extern "C"{
@@ -117,6 +119,21 @@ public:
     };
 
 
+    /* Work done by the engine, accumulated over evaluations */
+    struct EvaluationCounters
+    {
+        unsigned long evaluations;  /* Calls to eval or evalDetailed */
+        unsigned long games;        /* Games, including the ones read from the cache */
+        unsigned long pieces;       /* Pieces placed */
+        unsigned long afterstates;  /* Afterstates generated to choose the moves */
+        unsigned long lines;        /* Lines removed */
+        double wallSeconds;         /* Wall-clock time spent in the evaluations */
+        double cpuSeconds;          /* CPU time of the evaluating thread */
+    };
+
+    /* The game is the full geometry (board_width x board_height),
+     * used by evalDetailed and, unless setEvaluationGame is called,
+     * by eval as well */
     MDPTetris(int board_width, int board_height, int nb_games,
               Game *game, GamesStatistics *stats, std::string featureFile);
 
@@ -133,10 +150,6 @@ public:
     /* The function for evaluating a single feature policy */
     MDPTetrisDetailedResult evalDetailed(const SearchPointType &input) const;
 
-    /* Set the game data file */
-    void setGamedataFilename(std::string filename)
-    { m_gamedataFilename = filename; }
-
 
     /* Change the number of games played when evaulating */
     void setNbGames(unsigned int nbGames)
@@ -146,8 +159,80 @@ public:
     void enableLengthPenalty(bool _enable)
     { m_penalizeLength = _enable; }
 
+    /* Set the seed of the run, from which the seed
+     * of every game played is derived
+     */
+    void setRunSeed(unsigned long seed)
+    { m_runSeed = seed; }
+
+    /* Set the generation of the optimizer, games of
+     * different generations are played with different seeds
+     */
+    void setGeneration(unsigned int generation)
+    { m_generation = generation; }
+
+    /* When enabled (default), each candidate gets its own games.
+     * When disabled, all candidates of a generation play the
+     * same games (common random numbers).
+     */
+    void setSeedPerCandidate(bool _enable)
+    { m_seedPerCandidate = _enable; }
+
+    /* Use a cache of game scores, or NULL to always play the games.
+     * The cache is not owned by the objective function.
+     */
+    void setEvaluationCache(EvaluationCache *cache)
+    { m_cache = cache; }
+
+    /* Play the games of eval, i.e. the optimizer samples, on another
+     * game, typically a lower board on which games end sooner while
+     * the ranking of the candidates is mostly preserved. evalDetailed
+     * keeps playing on the full geometry. NULL goes back to the full
+     * geometry. The game is not owned by the objective function.
+     */
+    void setEvaluationGame(Game *game)
+    { m_evalGame = (game != NULL) ? game : m_game; }
+
+    /* Choose the moves with a two-ply search of the given number
+     * of best one-ply moves, or with a one-ply search if 0 (default).
+     * Slower, but the policies play much better.
+     */
+    void setLookahead(unsigned int nbCandidates)
+    { m_featurePolicy.lookahead_candidates = nbCandidates; }
+
+    /* Stop computing the features of a move once it cannot be
+     * the best one (default), or always compute all of them.
+     * The moves chosen, hence the scores, are the same.
+     */
+    void setLazyEvaluation(bool lazy)
+    { m_featurePolicy.lazy_evaluation = lazy ? 1 : 0; }
+
+    /* Work done since the last call to resetCounters */
+    const EvaluationCounters &counters(void) const
+    { return m_counters; }
+
+    /* Reset the counters, e.g. at the beginning of a generation */
+    void resetCounters(void)
+    { m_counters = EvaluationCounters(); }
+
 private:
 
+    /* Seed of the games played by a candidate, derived from
+     * the run seed, the generation and the weights of the candidate
+     */
+    unsigned long candidateSeed(const SearchPointType &input) const;
+
+    /* Play m_nbGames games, game i being played with the
+     * seed derived from the candidate seed and i
+     */
+    double playGames(const FeaturePolicy &policy, Game *game, unsigned long seed, GamesStatistics *stats) const;
+
+    /* Words identifying the outcome of the games of a policy,
+     * except for the game seed: features, reward, pieces,
+     * board geometry and weights
+     */
+    std::vector<uint64_t> cacheKeyWords(const FeaturePolicy &policy, const Game *game) const;
+
     /* The struct from the mdptetris
      * library that contains features of attention
      */
@@ -161,15 +246,15 @@ private:
 
     int m_boardWidth, m_boardHeight, m_nbGames;
 
-    /* Game object to use for evaluation */
+    /* Game with the full geometry, used by evalDetailed */
     Game *m_game;
 
+    /* Game used by eval, m_game unless an evaluation geometry is set */
+    Game *m_evalGame;
+
     /* Statistics object to store game stats */
     GamesStatistics *m_stats;
 
-    /* A filename to which game data is written */
-    std::string m_gamedataFilename;
-
     /* Info about last evaluation */
     unsigned int m_lastMinScore, m_lastMaxScore;
     double m_lastStandardDeviation;
@@ -180,6 +265,20 @@ private:
      */
     bool m_penalizeLength = false;
 
+    /* Seed hierarchy: run -> generation -> candidate -> game.
+     * The candidate is identified by its weights, so the games
+     * it plays do not depend on the order of evaluation.
+     */
+    unsigned long m_runSeed = 0;
+    unsigned int m_generation = 0;
+    bool m_seedPerCandidate = true;
+
+    /* Cache of game scores, NULL if disabled */
+    EvaluationCache *m_cache = NULL;
+
+    /* Work done by the evaluations */
+    mutable EvaluationCounters m_counters = EvaluationCounters();
+
 };
 
 #endif //EXAMPLEPROJECT_MDPTETRIS_H
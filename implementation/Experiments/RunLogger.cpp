@@ -0,0 +1,133 @@
+//
+// Buffered output of the run reports, written by a dedicated thread.
+//
+
+#include <iostream>
+#include <cstdlib>
+
+#include "RunLogger.h"
+
+/* Size of the stdio buffer of each file */
+#define RUN_LOGGER_FILE_BUFFER (1 << 16)
+
+RunLogger::RunLogger(std::size_t queueCapacity)
+    : m_queueCapacity(queueCapacity > 0 ? queueCapacity : 1), m_stopping(false)
+{
+    m_writer = std::thread(&RunLogger::writerLoop, this);
+}
+
+RunLogger::~RunLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_notEmpty.notify_one();
+    m_writer.join();
+
+    for (std::size_t i = 0; i < m_files.size(); i++)
+    {
+        fclose(m_files[i]);
+    }
+}
+
+int RunLogger::open(const std::string &filename, bool append)
+{
+    FILE *file = fopen(filename.c_str(), append ? "a" : "w");
+    if (file == NULL)
+    {
+        std::cerr << "Cannot open the output file " << filename << std::endl;
+        exit(1);
+    }
+    setvbuf(file, NULL, _IOFBF, RUN_LOGGER_FILE_BUFFER);
+
+    /* The writer only reads m_files under the lock */
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_files.push_back(file);
+    return m_files.size() - 1;
+}
+
+void RunLogger::write(int file, const std::string &line)
+{
+    Entry entry = { file, line, true };
+    push(entry);
+}
+
+void RunLogger::writeBytes(int file, const std::string &bytes)
+{
+    Entry entry = { file, bytes, false };
+    push(entry);
+}
+
+void RunLogger::push(const Entry &entry)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_queue.size() >= m_queueCapacity)
+        {
+            m_notFull.wait(lock);
+        }
+        m_queue.push_back(entry);
+    }
+    m_notEmpty.notify_one();
+}
+
+void RunLogger::flush(void)
+{
+    Entry entry = { -1, std::string(), false };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(entry);
+    }
+    m_notEmpty.notify_one();
+}
+
+void RunLogger::writerLoop(void)
+{
+    std::deque<Entry> batch;
+    std::vector<FILE *> files;
+
+    while (true)
+    {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_queue.empty() && !m_stopping)
+            {
+                m_notEmpty.wait(lock);
+            }
+            /* Take everything queued at once */
+            batch.swap(m_queue);
+            files = m_files;
+            stopping = m_stopping;
+        }
+        m_notFull.notify_all();
+
+        for (std::size_t i = 0; i < batch.size(); i++)
+        {
+            if (batch[i].file < 0)
+            {
+                for (std::size_t j = 0; j < files.size(); j++)
+                {
+                    fflush(files[j]);
+                }
+            }
+            else
+            {
+                FILE *file = files[batch[i].file];
+                fwrite(batch[i].line.data(), 1, batch[i].line.size(), file);
+                if (batch[i].endOfLine)
+                {
+                    fputc('\n', file);
+                }
+            }
+        }
+        batch.clear();
+
+        /* Nothing can be queued after the destructor was called */
+        if (stopping)
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+//
+// Buffered output of the run reports, written by a dedicated thread.
+//
+
+#ifndef EXAMPLEPROJECT_RUNLOGGER_H
+#define EXAMPLEPROJECT_RUNLOGGER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Writes lines of text to files kept open for the whole run.
+ *
+ * write() only queues the line, the files are written by a writer
+ * thread, so the optimizer never waits for the disk. When the queue
+ * holds queueCapacity lines, write() waits for the writer to catch
+ * up instead of dropping lines. flush() marks a point (e.g. the end
+ * of a generation) at which the writer hands everything written so
+ * far to the system. The destructor writes all pending lines and
+ * closes the files.
+ */
+class RunLogger {
+
+public:
+
+    explicit RunLogger(std::size_t queueCapacity = 4096);
+    ~RunLogger();
+
+    /* Open a file, truncated unless append is true.
+     * Returns the id to give to write() */
+    int open(const std::string &filename, bool append = false);
+
+    /* Queue a line, the end of line is added */
+    void write(int file, const std::string &line);
+
+    /* Queue raw bytes, written as they are */
+    void writeBytes(int file, const std::string &bytes);
+
+    /* Ask the writer to flush the files once the lines queued so far are written */
+    void flush(void);
+
+private:
+
+    /* A queued line, or a flush request if file is -1 */
+    struct Entry
+    {
+        int file;
+        std::string line;
+        bool endOfLine;
+    };
+
+    void push(const Entry &entry);
+    void writerLoop(void);
+
+    std::vector<FILE *> m_files;
+    std::deque<Entry> m_queue;
+    std::size_t m_queueCapacity;
+    bool m_stopping;
+
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty, m_notFull;
+    std::thread m_writer;
+
+    /* Non copyable */
+    RunLogger(const RunLogger &);
+    RunLogger &operator=(const RunLogger &);
+};
+
+#endif //EXAMPLEPROJECT_RUNLOGGER_H
@@ -0,0 +1,204 @@
+//
+// Per-generation run reports, as CSV text or as a binary trace.
+//
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "RunTrace.h"
+
+/* Size of the fixed part of the header */
+#define RUN_TRACE_FIXED_HEADER 24
+
+/* Little-endian encoding, whatever the host byte order */
+static void putUint32(std::string &bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        bytes.push_back((char) ((value >> (8 * i)) & 0xff));
+    }
+}
+
+static void putDouble(std::string &bytes, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++)
+    {
+        bytes.push_back((char) ((bits >> (8 * i)) & 0xff));
+    }
+}
+
+static uint32_t getUint32(const unsigned char *bytes)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--)
+    {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static double getDouble(const unsigned char *bytes)
+{
+    uint64_t bits = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        bits = (bits << 8) | bytes[i];
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string csvField(double value)
+{
+    std::stringstream s;
+    if (value == std::floor(value) && std::fabs(value) < 1e15)
+    {
+        s << (long long) value;
+    }
+    else
+    {
+        s << value;
+    }
+    return s.str();
+}
+
+RunTraceWriter::RunTraceWriter(RunLogger &logger, const std::string &filename, bool binary,
+                               const std::vector<std::string> &columns)
+    : m_logger(logger), m_binary(binary), m_nbColumns(columns.size())
+{
+    m_file = m_logger.open(filename);
+
+    if (!m_binary)
+    {
+        std::string line;
+        for (std::size_t i = 0; i < columns.size(); i++)
+        {
+            line += (i == 0 ? "" : ",") + columns[i];
+        }
+        m_logger.write(m_file, line);
+        return;
+    }
+
+    std::string names;
+    for (std::size_t i = 0; i < columns.size(); i++)
+    {
+        names += columns[i];
+        names.push_back('\0');
+    }
+    while ((RUN_TRACE_FIXED_HEADER + names.size()) % 8 != 0)
+    {
+        names.push_back('\0');
+    }
+
+    std::string header(RUN_TRACE_MAGIC, 8);
+    putUint32(header, RUN_TRACE_VERSION);
+    putUint32(header, columns.size());
+    putUint32(header, RUN_TRACE_FIXED_HEADER + names.size());
+    putUint32(header, 0);
+    header += names;
+    m_logger.writeBytes(m_file, header);
+}
+
+void RunTraceWriter::write(const std::vector<double> &values)
+{
+    if (values.size() != m_nbColumns)
+    {
+        std::cerr << "Run trace row has " << values.size() << " values for "
+                  << m_nbColumns << " columns" << std::endl;
+        exit(1);
+    }
+
+    if (!m_binary)
+    {
+        std::string line;
+        for (std::size_t i = 0; i < values.size(); i++)
+        {
+            line += (i == 0 ? "" : ",") + csvField(values[i]);
+        }
+        m_logger.write(m_file, line);
+        return;
+    }
+
+    std::string record;
+    record.reserve(8 * values.size());
+    for (std::size_t i = 0; i < values.size(); i++)
+    {
+        putDouble(record, values[i]);
+    }
+    m_logger.writeBytes(m_file, record);
+}
+
+RunTraceReader::RunTraceReader(const std::string &filename)
+    : m_nbRecords(0), m_mappedSize(0), m_mapping(NULL), m_records(NULL)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (fd == -1 || fstat(fd, &fileStat) != 0)
+    {
+        std::cerr << "Cannot open the run trace " << filename << std::endl;
+        exit(1);
+    }
+
+    m_mappedSize = fileStat.st_size;
+    if (m_mappedSize >= RUN_TRACE_FIXED_HEADER)
+    {
+        m_mapping = mmap(NULL, m_mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    const unsigned char *bytes = static_cast<const unsigned char *>(m_mapping);
+    if (m_mapping == NULL || m_mapping == MAP_FAILED
+        || std::memcmp(bytes, RUN_TRACE_MAGIC, 8) != 0
+        || getUint32(bytes + 8) != RUN_TRACE_VERSION)
+    {
+        std::cerr << "Invalid run trace " << filename << std::endl;
+        exit(1);
+    }
+
+    std::size_t nbColumns = getUint32(bytes + 12);
+    std::size_t headerSize = getUint32(bytes + 16);
+    if (headerSize > m_mappedSize || headerSize % 8 != 0 || nbColumns == 0)
+    {
+        std::cerr << "Invalid run trace header " << filename << std::endl;
+        exit(1);
+    }
+
+    /* Column names */
+    std::size_t offset = RUN_TRACE_FIXED_HEADER;
+    for (std::size_t i = 0; i < nbColumns; i++)
+    {
+        const void *end = std::memchr(bytes + offset, '\0', headerSize - offset);
+        if (end == NULL)
+        {
+            std::cerr << "Invalid run trace column names " << filename << std::endl;
+            exit(1);
+        }
+        std::size_t length = static_cast<const unsigned char *>(end) - (bytes + offset);
+        m_columns.push_back(std::string(reinterpret_cast<const char *>(bytes + offset), length));
+        offset += length + 1;
+    }
+
+    m_records = bytes + headerSize;
+    m_nbRecords = (m_mappedSize - headerSize) / (8 * nbColumns);
+}
+
+RunTraceReader::~RunTraceReader()
+{
+    munmap(m_mapping, m_mappedSize);
+}
+
+double RunTraceReader::value(std::size_t record, std::size_t column) const
+{
+    return getDouble(m_records + 8 * (record * m_columns.size() + column));
+}
@@ -0,0 +1,90 @@
+//
+// Per-generation run reports, as CSV text or as a binary trace.
+//
+
+#ifndef EXAMPLEPROJECT_RUNTRACE_H
+#define EXAMPLEPROJECT_RUNTRACE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#include "RunLogger.h"
+
+/*
+ * Binary trace format, all numbers little-endian:
+ *
+ *   char     magic[8]      "MDPTRACE"
+ *   uint32   version       1
+ *   uint32   nbColumns
+ *   uint32   headerSize    offset of the first record, multiple of 8
+ *   uint32   reserved      0
+ *   char     names[]       nbColumns NUL-terminated column names,
+ *                          padded with zeros up to headerSize
+ *
+ * followed by one record per row: nbColumns IEEE 754 doubles. The
+ * file is only ever appended to, so a trace can be read while the run
+ * is still writing it (an incomplete last record is ignored).
+ */
+#define RUN_TRACE_MAGIC   "MDPTRACE"
+#define RUN_TRACE_VERSION 1
+
+/* Text of a value in a CSV row: integers are written without exponent */
+std::string csvField(double value);
+
+/*
+ * Writes the rows of a run report through a RunLogger, either as CSV
+ * text or as a binary trace. The header is written by the constructor.
+ */
+class RunTraceWriter {
+
+public:
+
+    RunTraceWriter(RunLogger &logger, const std::string &filename, bool binary,
+                   const std::vector<std::string> &columns);
+
+    /* Append a row, one value per column */
+    void write(const std::vector<double> &values);
+
+    bool binary(void) const { return m_binary; }
+
+private:
+
+    RunLogger &m_logger;
+    int m_file;
+    bool m_binary;
+    std::size_t m_nbColumns;
+};
+
+/*
+ * Read-only view of a binary trace, mapped in memory.
+ */
+class RunTraceReader {
+
+public:
+
+    explicit RunTraceReader(const std::string &filename);
+    ~RunTraceReader();
+
+    const std::vector<std::string> &columns(void) const { return m_columns; }
+
+    /* Number of complete records when the file was opened */
+    std::size_t nbRecords(void) const { return m_nbRecords; }
+
+    double value(std::size_t record, std::size_t column) const;
+
+private:
+
+    std::vector<std::string> m_columns;
+    std::size_t m_nbRecords;
+    std::size_t m_mappedSize;
+    void *m_mapping;
+    const unsigned char *m_records;
+
+    /* Non copyable */
+    RunTraceReader(const RunTraceReader &);
+    RunTraceReader &operator=(const RunTraceReader &);
+};
+
+#endif //EXAMPLEPROJECT_RUNTRACE_H
@@ -0,0 +1,782 @@
+//
+// Benchmark of the mdptetris engine hot paths.
+//
+// Every measurement runs on fixed board snapshots and on fixed piece
+// sequences derived from -seed, so that two builds of the engine can be
+// compared run against run.
+//
+// Usage: EngineBenchmark [-policy=features/record_du.dat] [-pieceFile=pieces4.dat]
+//                        [-seed=1] [-minTime=0.2] [-gameHeight=10] [-nbGames=3]
+//        EngineBenchmark -replay=sequences/golden.dat
+//        EngineBenchmark -scaling=8 [-pin=1] [-policy=...] [-gameHeight=10] [-seed=1]
+//
+// With -replay, the games listed in the given file are replayed on their
+// checked-in piece sequences and their number of lines must match exactly.
+// Each game is then replayed once more, checking at every move that the
+// lazy evaluation of the features chooses the move of the full evaluation.
+// The exit status is 1 if any game differs, so that an engine change can be
+// checked to preserve the behaviour and timed in one command.
+//
+// With -scaling=N, a fixed population of policies is evaluated on 1, 2, 4, ...
+// N threads, each thread playing with its own game. -pin=1 pins thread i to
+// processor i.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "cconfig.h"
+
+extern "C"{
+#include "board.h"
+#include "game.h"
+#include "brick_masks.h"
+#include "feature_functions.h"
+#include "feature_policy.h"
+#include "random.h"
+};
+
+#define OPT_POLICY       "-policy"
+#define OPT_PIECE_FILE   "-pieceFile"
+#define OPT_SEED         "-seed"
+
+/* Minimum duration of each measurement, in seconds */
+#define OPT_MIN_TIME     "-minTime"
+
+/* Board height and number of games for the full game benchmark */
+#define OPT_GAME_HEIGHT  "-gameHeight"
+#define OPT_NB_GAMES     "-nbGames"
+
+/* File listing the golden games to replay */
+#define OPT_REPLAY       "-replay"
+
+/* Maximum number of threads of the scaling benchmark, and thread pinning */
+#define OPT_SCALING      "-scaling"
+#define OPT_PIN          "-pin"
+
+const std::string known_opts[]
+        = {OPT_POLICY,OPT_PIECE_FILE,OPT_SEED,OPT_MIN_TIME,OPT_GAME_HEIGHT,OPT_NB_GAMES,
+           OPT_REPLAY,OPT_SCALING,OPT_PIN,"STOP"};
+
+/* Number of policies evaluated by the scaling benchmark */
+#define SCALING_POPULATION 100
+
+/* Number of rows of the longest snapshot */
+#define SNAPSHOT_MAX_ROWS 16
+
+/* A fixed 10 columns wide board, given from top to bottom.
+ * 'X' is a full cell, the rows above the listed ones are empty.
+ */
+struct BoardSnapshot
+{
+    const char *name;
+    const char *rows[SNAPSHOT_MAX_ROWS + 1];
+};
+
+static const BoardSnapshot snapshots[] =
+{
+    { "empty",  { NULL } },
+    { "flat",   { "X.XX.XXXX.",
+                  "XXXXX.XXXX",
+                  "XXXX.XXXXX",
+                  NULL } },
+    { "holes",  { "....X.....",
+                  "X..XX...X.",
+                  "XX.X.XX.XX",
+                  "X.XXX.XXX.",
+                  "XXX.XXXX.X",
+                  "X.XXXX.XXX",
+                  "XXXX.XXXXX",
+                  NULL } },
+    { "tall",   { ".........X",
+                  "X........X",
+                  "XX......XX",
+                  "XX.X...XXX",
+                  "XXXX..XXXX",
+                  "XXXXX.XXXX",
+                  "XX.XXXXX.X",
+                  "XXXX.XXXXX",
+                  "X.XXXXXXXX",
+                  "XXXXXX.XXX",
+                  "XXX.XXXXXX",
+                  "XXXXXXXX.X",
+                  "X.XXXXXXXX",
+                  "XXXXX.XXXX",
+                  NULL } },
+};
+
+static const int nbSnapshots = sizeof(snapshots) / sizeof(snapshots[0]);
+
+/* Keeps the compiler from removing the measured calls */
+static volatile double sink;
+
+/* Puts a snapshot on the board of a game */
+static void loadSnapshot(Game *game, const BoardSnapshot &snapshot)
+{
+    Board *board = game->board;
+    int nbRows = 0;
+    while (snapshot.rows[nbRows] != NULL)
+    {
+        nbRows++;
+    }
+
+    board_reset(board);
+    for (int i = 0; i < nbRows; i++)
+    {
+        const char *row = snapshot.rows[nbRows - 1 - i];
+        for (int j = 0; row[j] != '\0' && j < board->width; j++)
+        {
+            if (row[j] == 'X')
+            {
+                board->rows[i] |= brick_masks[j + 1];
+            }
+        }
+    }
+    board->wall_height = nbRows;
+    board_update_column_heights(board);
+}
+
+/* Calls op until minTime seconds have elapsed, returns the time of one call in ns */
+template<class Operation>
+static double measure(Operation op, double minTime)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::size_t nbCalls = 1;
+    while (true)
+    {
+        Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < nbCalls; i++)
+        {
+            op();
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed >= minTime)
+        {
+            return elapsed * 1e9 / nbCalls;
+        }
+        nbCalls *= 2;
+    }
+}
+
+/* Prints a result line: ns/op and, if rates is not empty, some rates per second */
+static void report(const std::string &name, double nsPerOp,
+                   const std::vector<std::pair<std::string, double> > &rates
+                       = std::vector<std::pair<std::string, double> >())
+{
+    std::cout << std::left << std::setw(52) << name
+              << std::right << std::setw(12) << std::fixed << std::setprecision(1) << nsPerOp << " ns/op";
+    for (std::size_t i = 0; i < rates.size(); i++)
+    {
+        std::cout << std::setw(14) << std::setprecision(0) << rates[i].second << " " << rates[i].first;
+    }
+    std::cout << std::endl;
+}
+
+/* Number of afterstates of the current piece */
+static int nbAfterstates(Game *game)
+{
+    int nb = 0;
+    for (int i = 0; i < game_get_nb_possible_orientations(game); i++)
+    {
+        nb += game_get_nb_possible_columns(game, i);
+    }
+    return nb;
+}
+
+/* board_drop_piece, board_cancel_last_move and board_update_column_heights */
+static void benchmarkBoard(Game *game, double minTime)
+{
+    Board *board = game->board;
+    PieceConfiguration *configuration = game->piece_configuration;
+    LastMoveInfo lastMoveInfo;
+
+    for (int s = 0; s < nbSnapshots; s++)
+    {
+        loadSnapshot(game, snapshots[s]);
+
+        /* All the moves of all the pieces */
+        std::vector<Action> actions;
+        std::vector<PieceOrientation *> orientations;
+        for (int p = 0; p < configuration->nb_pieces; p++)
+        {
+            Piece *piece = &configuration->pieces[p];
+            for (int o = 0; o < piece->nb_orientations; o++)
+            {
+                for (int c = 1; c <= board->width - piece->orientations[o].width + 1; c++)
+                {
+                    Action action = { o, c };
+                    actions.push_back(action);
+                    orientations.push_back(&piece->orientations[o]);
+                }
+            }
+        }
+
+        std::size_t next = 0;
+        double ns = measure([&]() {
+            board_drop_piece(board, orientations[next], actions[next].orientation,
+                             actions[next].column, &lastMoveInfo, 1);
+            board_cancel_last_move(board);
+            next = (next + 1 == actions.size()) ? 0 : next + 1;
+        }, minTime);
+        report(std::string("board_drop_piece+cancel [") + snapshots[s].name + "]", ns);
+
+        /* Two nested moves, as in a two-ply search */
+        next = 0;
+        ns = measure([&]() {
+            std::size_t second = (next + actions.size() / 2) % actions.size();
+            board_drop_piece(board, orientations[next], actions[next].orientation,
+                             actions[next].column, &lastMoveInfo, 1);
+            board_drop_piece(board, orientations[second], actions[second].orientation,
+                             actions[second].column, &lastMoveInfo, 1);
+            board_cancel_last_move(board);
+            board_cancel_last_move(board);
+            next = (next + 1 == actions.size()) ? 0 : next + 1;
+        }, minTime);
+        report(std::string("board_drop_piece+cancel x2 [") + snapshots[s].name + "]", ns);
+
+        ns = measure([&]() {
+            board_update_column_heights(board);
+            sink = board->column_heights[1];
+        }, minTime);
+        report(std::string("board_update_column_heights [") + snapshots[s].name + "]", ns);
+    }
+}
+
+/* Each feature function, on the afterstate of a move on each snapshot */
+static void benchmarkFeatures(Game *game, const FeaturePolicy *policy, double minTime)
+{
+    Action action = { 0, 1 };
+
+    for (FeatureID id = (FeatureID) -NB_ORIGINAL_FEATURES; id <= MAX_HEIGHT_DIFFERENCE; id = (FeatureID) (id + 1))
+    {
+        FeatureFunction *function = feature_function(id);
+
+        /* Not implemented, or needs the value function file */
+        if (function == NULL || (id == NEXT_LOCAL_VALUE_FUNCTION && !contains_feature(policy, id)))
+        {
+            continue;
+        }
+
+        for (int s = 0; s < nbSnapshots; s++)
+        {
+            loadSnapshot(game, snapshots[s]);
+            game_set_current_piece_index(game, 0);
+            game_drop_piece(game, &action, 1);
+            board_update_column_heights(game->board);
+
+            double ns = measure([&]() {
+                sink = function(game);
+            }, minTime);
+
+            std::stringstream name;
+            name << "feature " << id << " [" << snapshots[s].name << "]";
+            report(name.str(), ns);
+            game_cancel_last_move(game);
+        }
+    }
+
+    for (int s = 0; s < nbSnapshots; s++)
+    {
+        loadSnapshot(game, snapshots[s]);
+        game_set_current_piece_index(game, 0);
+        game_drop_piece(game, &action, 1);
+
+        double ns = measure([&]() {
+            sink = evaluate_features(game, policy);
+        }, minTime);
+        report(std::string("evaluate_features [") + snapshots[s].name + "]", ns,
+               {{"afterstates/s", 1e9 / ns}});
+        game_cancel_last_move(game);
+    }
+}
+
+/* features_get_best_action for each piece on each snapshot */
+static void benchmarkBestAction(Game *game, const FeaturePolicy *policy, double minTime)
+{
+    for (int s = 0; s < nbSnapshots; s++)
+    {
+        loadSnapshot(game, snapshots[s]);
+
+        /* Cycle through the pieces */
+        int piece = 0;
+        double ns = measure([&]() {
+            game_set_current_piece_index(game, piece);
+            Action action;
+            features_get_best_action(game, policy, &action);
+            sink = action.column;
+            piece = (piece + 1) % game->piece_configuration->nb_pieces;
+        }, minTime);
+
+        double meanAfterstates = 0;
+        for (int p = 0; p < game->piece_configuration->nb_pieces; p++)
+        {
+            game_set_current_piece_index(game, p);
+            meanAfterstates += nbAfterstates(game);
+        }
+        meanAfterstates /= game->piece_configuration->nb_pieces;
+
+        report(std::string("features_get_best_action [") + snapshots[s].name + "]", ns,
+               {{"pieces/s", 1e9 / ns}, {"afterstates/s", 1e9 * meanAfterstates / ns}});
+
+        /* Same moves, skipping the features of the moves that cannot be the best one */
+        FeaturePolicy lazyPolicy = *policy;
+        lazyPolicy.lazy_evaluation = 1;
+        ns = measure([&]() {
+            game_set_current_piece_index(game, piece);
+            Action action;
+            features_get_best_action(game, &lazyPolicy, &action);
+            sink = action.column;
+            piece = (piece + 1) % game->piece_configuration->nb_pieces;
+        }, minTime);
+        report(std::string("features_get_best_action lazy [") + snapshots[s].name + "]", ns,
+               {{"pieces/s", 1e9 / ns}, {"afterstates/s", 1e9 * meanAfterstates / ns}});
+
+        /* Two-ply search of the best moves */
+        FeaturePolicy lookaheadPolicy = *policy;
+        lookaheadPolicy.lookahead_candidates = 4;
+        ns = measure([&]() {
+            game_set_current_piece_index(game, piece);
+            Action action;
+            features_get_best_action(game, &lookaheadPolicy, &action);
+            sink = action.column;
+            piece = (piece + 1) % game->piece_configuration->nb_pieces;
+        }, minTime);
+        report(std::string("features_get_best_action lookahead 4 [") + snapshots[s].name + "]", ns,
+               {{"pieces/s", 1e9 / ns}});
+    }
+}
+
+/* Full games of feature_policy_play_game, game i on the fixed piece sequence i */
+static void benchmarkGames(const std::string &piecesFile, int gameHeight,
+                           const FeaturePolicy *policy, int nbGames, unsigned long seed)
+{
+    typedef std::chrono::steady_clock Clock;
+    long pieces = 0, afterstates = 0, lines = 0;
+    double elapsed = 0;
+
+    /* Longer than any game on a small board */
+    const int sequenceLength = 1 << 20;
+    std::vector<int> sequence(sequenceLength + 1);
+    sequence[sequenceLength] = -1;
+
+    for (int i = 0; i < nbGames; i++)
+    {
+        Game *game = new_game(0, 10, gameHeight, 0, piecesFile.c_str(), &sequence[0]);
+        int nbPieces = game->piece_configuration->nb_pieces;
+        unsigned long sequenceSeed = random_derive_seed(seed, i);
+        for (int k = 0; k < sequenceLength; k++)
+        {
+            sequence[k] = random_derive_seed(sequenceSeed, k) % nbPieces;
+        }
+
+        Clock::time_point start = Clock::now();
+        feature_policy_play_game(policy, game);
+        elapsed += std::chrono::duration<double>(Clock::now() - start).count();
+
+        /* The sequence restarts when it is over, the game would replay its first pieces */
+        if (game->counters.nb_pieces >= sequenceLength)
+        {
+            std::cerr << "Warning: the game used the whole piece sequence" << std::endl;
+        }
+        pieces += game->counters.nb_pieces;
+        afterstates += game->counters.nb_afterstates;
+        lines += game->counters.nb_lines;
+        free_game(game);
+    }
+
+    std::stringstream name;
+    name << "feature_policy_play_game [" << nbGames << " games, " << lines << " lines]";
+    report(name.str(), elapsed * 1e9 / pieces,
+           {{"pieces/s", pieces / elapsed}, {"afterstates/s", afterstates / elapsed}});
+}
+
+/* Loads a sequence of pieces: the number of pieces, then the piece indexes.
+ * The returned sequence ends with -1, as expected by new_game. */
+static std::vector<int> loadSequence(const std::string &fileName)
+{
+    std::ifstream file(fileName.c_str());
+    int length = 0;
+    if (!(file >> length) || length <= 0)
+    {
+        std::cerr << "Cannot read the piece sequence " << fileName << std::endl;
+        exit(1);
+    }
+
+    std::vector<int> sequence(length + 1);
+    for (int i = 0; i < length; i++)
+    {
+        if (!(file >> sequence[i]))
+        {
+            std::cerr << "Piece sequence " << fileName << " is too short" << std::endl;
+            exit(1);
+        }
+    }
+    sequence[length] = -1;
+    return sequence;
+}
+
+/* Replays a game on its piece sequence and returns the number of moves where
+ * the lazy evaluation of the features does not choose the move of the full
+ * evaluation. The game goes on with the moves of the full evaluation, and its
+ * counters are those of this replay only. */
+static long countLazyMismatches(const FeaturePolicy *policy, Game *game)
+{
+    FeaturePolicy fullPolicy = *policy, lazyPolicy = *policy;
+    fullPolicy.lazy_evaluation = 0;
+    lazyPolicy.lazy_evaluation = 1;
+
+    long mismatches = 0;
+    game_reset(game);
+    game_reset_counters(game);
+    while (!game->game_over)
+    {
+        Action fullAction, lazyAction;
+        features_get_best_action(game, &fullPolicy, &fullAction);
+        features_get_best_action(game, &lazyPolicy, &lazyAction);
+        if (fullAction.orientation != lazyAction.orientation || fullAction.column != lazyAction.column)
+        {
+            mismatches++;
+        }
+        game_drop_piece(game, &fullAction, 0);
+    }
+    return mismatches;
+}
+
+/* Replays the golden games listed in a file and checks their number of lines.
+ * Each line of the file is: policy sequence pieces width height lines,
+ * the file names being relative to the data folder. Lines starting with
+ * '#' are comments. Returns the number of games that differ. */
+static int replayGolden(const std::string &goldenFile)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::ifstream file(goldenFile.c_str());
+    if (!file)
+    {
+        std::cerr << "Cannot read the golden games " << goldenFile << std::endl;
+        exit(1);
+    }
+
+    int nbGames = 0, nbFailures = 0;
+    long totalPieces = 0;
+    double totalElapsed = 0;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string policyFile, sequenceFile, piecesFile;
+        int width, height, expectedLines;
+        if (!(fields >> policyFile >> sequenceFile >> piecesFile >> width >> height >> expectedLines))
+        {
+            std::cerr << "Ill formed golden game: " << line << std::endl;
+            exit(1);
+        }
+
+        FeaturePolicy policy;
+        load_feature_policy(MDPTETRIS_DATA_PATH(policyFile).c_str(), &policy);
+        features_initialize(&policy);
+
+        std::vector<int> sequence = loadSequence(MDPTETRIS_DATA_PATH(sequenceFile));
+        Game *game = new_game(0, width, height, 0, MDPTETRIS_DATA_PATH(piecesFile).c_str(), &sequence[0]);
+
+        Clock::time_point start = Clock::now();
+        feature_policy_play_game(&policy, game);
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        long pieces = game->counters.nb_pieces;
+        long sequenceLength = sequence.size() - 1;
+        bool ok = game->score == expectedLines;
+
+        std::stringstream name;
+        name << "replay " << policyFile << " " << sequenceFile << " " << width << "x" << height;
+        report(name.str(), elapsed * 1e9 / pieces, {{"pieces/s", pieces / elapsed}});
+
+        /* The sequence restarts when it is over: the game would not be the one of the sequence */
+        if (pieces >= sequenceLength)
+        {
+            std::cout << "  MISMATCH: the game used the whole piece sequence ("
+                      << sequenceLength << " pieces)" << std::endl;
+            nbFailures++;
+        }
+        else if (!ok)
+        {
+            std::cout << "  MISMATCH: " << game->score << " lines, expected " << expectedLines << std::endl;
+            nbFailures++;
+        }
+        else
+        {
+            long lazyMismatches = countLazyMismatches(&policy, game);
+            if (game->counters.nb_pieces >= sequenceLength)
+            {
+                std::cout << "  MISMATCH: the lazy check used the whole piece sequence ("
+                          << sequenceLength << " pieces)" << std::endl;
+                nbFailures++;
+            }
+            else if (lazyMismatches > 0 || game->score != expectedLines)
+            {
+                std::cout << "  MISMATCH: the lazy evaluation chose " << lazyMismatches
+                          << " other moves" << std::endl;
+                nbFailures++;
+            }
+        }
+
+        nbGames++;
+        totalPieces += pieces;
+        totalElapsed += elapsed;
+
+        free_game(game);
+        free(policy.features);
+        features_exit();
+    }
+
+    std::cout << nbGames - nbFailures << "/" << nbGames << " golden games matched, "
+              << totalPieces << " pieces in " << std::setprecision(3) << totalElapsed << " s" << std::endl;
+
+    return nbFailures;
+}
+
+/* Work done by one run of the scaling benchmark */
+struct ScalingRun
+{
+    double elapsed;
+    long pieces;
+    long lines;
+};
+
+/* Evaluates the population with nbThreads threads: each thread owns one game
+ * and takes the next policy to evaluate until there is none left. Policy k
+ * is always played with the same game seed, so the work does not depend on
+ * the number of threads. */
+static ScalingRun evaluatePopulation(const std::vector<FeaturePolicy> &population,
+                                     std::vector<Game *> &games, int nbThreads,
+                                     bool pin, unsigned long seed)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::atomic<int> nextPolicy(0);
+    std::atomic<long> pieces(0), lines(0);
+    int nbProcessors = std::thread::hardware_concurrency();
+
+    Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nbThreads; t++)
+    {
+        threads.push_back(std::thread([&, t]() {
+            Game *game = games[t];
+            game_reset_counters(game);
+            int k;
+            while ((k = nextPolicy++) < (int) population.size())
+            {
+                game_set_seed(game, random_derive_seed(seed, k));
+                feature_policy_play_game(&population[k], game);
+            }
+            pieces += game->counters.nb_pieces;
+            lines += game->counters.nb_lines;
+        }));
+
+        if (pin && nbProcessors > 0)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(t % nbProcessors, &cpus);
+            pthread_setaffinity_np(threads[t].native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+
+    for (int t = 0; t < nbThreads; t++)
+    {
+        threads[t].join();
+    }
+
+    ScalingRun run;
+    run.elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    run.pieces = pieces;
+    run.lines = lines;
+    return run;
+}
+
+/* Evaluates a population of policies on 1, 2, 4, ... maxThreads threads.
+ * The population is made of the given policy with perturbed weights. */
+static int benchmarkScaling(const std::string &piecesFile, int gameHeight,
+                            const FeaturePolicy *policy, int maxThreads, bool pin,
+                            unsigned long seed)
+{
+    std::vector<FeaturePolicy> population(SCALING_POPULATION);
+    for (int k = 0; k < SCALING_POPULATION; k++)
+    {
+        population[k] = *policy;
+        population[k].features = (Feature *) malloc(policy->nb_features * sizeof(Feature));
+        for (int i = 0; i < policy->nb_features; i++)
+        {
+            /* Weights scaled by a factor in [0.75, 1.25) */
+            double u = (random_derive_seed(random_derive_seed(seed, SCALING_POPULATION + k), i) >> 11)
+                       * (1.0 / 9007199254740992.0);
+            population[k].features[i] = policy->features[i];
+            population[k].features[i].weight *= 0.75 + 0.5 * u;
+        }
+    }
+
+    /* The games are created here because new_game draws
+     * its first piece from the global random generator */
+    std::vector<Game *> games(maxThreads);
+    for (int t = 0; t < maxThreads; t++)
+    {
+        games[t] = new_game(0, 10, gameHeight, 0, piecesFile.c_str(), NULL);
+    }
+
+    std::vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n *= 2)
+    {
+        threadCounts.push_back(n);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::cout << SCALING_POPULATION << " policies on a 10x" << gameHeight << " board"
+              << (pin ? ", pinned threads" : "") << std::endl;
+    std::cout << std::fixed << std::setw(8) << "threads" << std::setw(12) << "seconds" << std::setw(10) << "speedup"
+              << std::setw(12) << "efficiency" << std::setw(20) << "pieces/s/thread" << std::endl;
+
+    int nbMismatches = 0;
+    ScalingRun reference;
+    for (std::size_t i = 0; i < threadCounts.size(); i++)
+    {
+        int n = threadCounts[i];
+        ScalingRun run = evaluatePopulation(population, games, n, pin, seed);
+        if (i == 0)
+        {
+            reference = run;
+        }
+
+        double speedup = reference.elapsed / run.elapsed;
+        std::cout << std::setw(8) << n << std::setw(12) << std::setprecision(3) << run.elapsed
+                  << std::setw(10) << std::setprecision(2) << speedup
+                  << std::setw(12) << speedup / n
+                  << std::setw(20) << std::setprecision(0) << run.pieces / (run.elapsed * n) << std::endl;
+
+        /* Same games whatever the number of threads */
+        if (run.pieces != reference.pieces || run.lines != reference.lines)
+        {
+            std::cout << "  MISMATCH: " << run.lines << " lines, expected " << reference.lines << std::endl;
+            nbMismatches++;
+        }
+    }
+
+    for (int t = 0; t < maxThreads; t++)
+    {
+        free_game(games[t]);
+    }
+    for (int k = 0; k < SCALING_POPULATION; k++)
+    {
+        free(population[k].features);
+    }
+
+    return nbMismatches;
+}
+
+/* Value of an option, or its default value if not given */
+static std::string optionValue(std::map<std::string, std::string> &options,
+                               const std::string &key, const std::string &defaultValue)
+{
+    return options.count(key) == 1 ? options[key] : defaultValue;
+}
+
+int main( int argc, char ** argv )
+{
+    std::vector<std::string> all_options;
+    for (int i = 0; known_opts[i].compare("STOP") != 0; i++)
+    {
+        all_options.push_back(known_opts[i]);
+    }
+
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string opt = argv[i];
+        size_t del_pos = opt.find("=");
+        if (del_pos == std::string::npos || del_pos+1 == opt.size())
+        {
+            std::cerr << "Ill posed command line argument: " << argv[i] << std::endl;
+            return 64;
+        }
+
+        std::string key = opt.substr(0, del_pos);
+        if (std::find(all_options.begin(), all_options.end(), key) == all_options.end())
+        {
+            std::cerr << "Option is unknown, aborting! " << key << std::endl;
+            return 64;
+        }
+        options[key] = opt.substr(del_pos+1);
+    }
+
+    std::string policyFile = MDPTETRIS_DATA_PATH(optionValue(options, OPT_POLICY, "features/record_du.dat"));
+    std::string piecesFile = MDPTETRIS_DATA_PATH(optionValue(options, OPT_PIECE_FILE, "pieces4.dat"));
+    unsigned long seed = strtoul(optionValue(options, OPT_SEED, "1").c_str(), NULL, 10);
+    double minTime = atof(optionValue(options, OPT_MIN_TIME, "0.2").c_str());
+    int gameHeight = atoi(optionValue(options, OPT_GAME_HEIGHT, "10").c_str());
+    int nbGames = atoi(optionValue(options, OPT_NB_GAMES, "3").c_str());
+
+    /* Only needed to draw the first piece of a new game */
+    initialize_random_generator(seed);
+
+    if (options.count(OPT_REPLAY) == 1)
+    {
+        int nbFailures = replayGolden(MDPTETRIS_DATA_PATH(options[OPT_REPLAY]));
+        exit_random_generator();
+        return nbFailures == 0 ? 0 : 1;
+    }
+
+    FeaturePolicy policy;
+    load_feature_policy(policyFile.c_str(), &policy);
+    features_initialize(&policy);
+
+    if (options.count(OPT_SCALING) == 1)
+    {
+        /* 0 means as many threads as processors */
+        int maxThreads = atoi(options[OPT_SCALING].c_str());
+        if (maxThreads < 1)
+        {
+            maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        bool pin = atoi(optionValue(options, OPT_PIN, "0").c_str()) != 0;
+        int nbMismatches = benchmarkScaling(piecesFile, gameHeight, &policy, maxThreads, pin, seed);
+        features_exit();
+        exit_random_generator();
+        return nbMismatches == 0 ? 0 : 1;
+    }
+
+    /* Snapshots are played on a standard board */
+    Game *game = new_game(0, 10, 20, 0, piecesFile.c_str(), NULL);
+
+    std::cout << "Policy             : " << policyFile << std::endl;
+    std::cout << "Pieces             : " << piecesFile << std::endl;
+    std::cout << "Sequence seed      : " << seed << std::endl;
+
+    benchmarkBoard(game, minTime);
+    benchmarkFeatures(game, &policy, minTime);
+    benchmarkBestAction(game, &policy, minTime);
+    free_game(game);
+
+    benchmarkGames(piecesFile, gameHeight, &policy, nbGames, seed);
+
+    features_exit();
+    exit_random_generator();
+
+    return 0;
+}
@@ -4,7 +4,7 @@
  * @brief The Tetris board
  *
  * This module handles the game board. The board is composed by an array of rows.
- * Each row is represented by a 16-bit integer.
+ * Each row is represented by an integer (a BoardRow, 16 bits by default).
  *
  * @{
  */
@@ -16,11 +16,38 @@
 #include "piece.h"
 #include "last_move_info.h"
 
+/**
+ * @brief Maximum number of nested moves that can be cancelled.
+ *
+ * A search can drop up to this number of cancellable pieces on top of
+ * each other before it cancels them.
+ */
+#ifndef BOARD_UNDO_DEPTH
+#define BOARD_UNDO_DEPTH 8
+#endif
+
+/**
+ * @brief Information needed to cancel a move.
+ *
+ * Only the rows changed by the move are saved: the rows from the bottom of
+ * the piece to the top of the wall. Their content is stored in the
+ * \c undo_rows of the board.
+ */
+typedef struct BoardUndo {
+  int first_row;        /**< Index of the first row saved. */
+  int nb_rows;          /**< Number of rows saved. */
+  int wall_height;      /**< The wall height before the move. */
+} BoardUndo;
+
 /**
  * @brief The game board.
  *
  * The rows are numeroted from bottom to top, starting with 0.
  * The columns are numeroted from left to right, starting with 1 (actually column 0 is the left border).
+ *
+ * A board and its arrays (rows, column heights and undo log) are stored in one block
+ * of \c block_size bytes, aligned on a cache line, where each array starts on a cache line.
+ * Copying a board is thus a single copy of the block (up to the undo rows in use).
  */
 struct Board {
   /**
@@ -30,7 +57,7 @@ struct Board {
   int height;           /**< Number of rows in the board (20 in standard Tetris). */
   int extended_height;  /**< Number of rows in the internal representation of board (24 in standard Tetris). */
   int allow_lines_after_overflow;  /**< enable the lines completion when the piece overflows? */
-  uint16_t *rows;       /**< Board state: array of rows where each row is represented with an integer. */
+  BoardRow *rows;       /**< Board state: array of rows where each row is represented with an integer. */
 
   /**
    * @name Information stored to improve the speed
@@ -43,14 +70,28 @@ struct Board {
   /**
    * @name Bit masks depending on the board size
    */
-  uint16_t empty_row;   /**< 16-bit integer representing an empty row (for the standard board size: 1000000000011111). */
-  uint16_t full_row;    /**< 16-bit integer representing a full row (for the standard board size: 1111111111111111). */
+  BoardRow empty_row;   /**< row representing an empty row (for the standard board size: 1000000000011111). */
+  BoardRow full_row;    /**< row representing a full row (for the standard board size: 1111111111111111). */
+
+  /**
+   * @name Information needed to cancel the last moves
+   */
+  BoardUndo *undo_log;      /**< Stack of the moves that can be cancelled (BOARD_UNDO_DEPTH elements). */
+  int undo_depth;           /**< Number of moves in the stack. */
+  BoardRow *undo_rows;      /**< Rows saved by the moves of the stack, one after another. */
+  int nb_undo_rows;         /**< Number of rows used in \c undo_rows. */
+
+  /**
+   * @name Implementation chosen for the board size
+   */
+  int (*drop_piece)(Board *board, PieceOrientation *oriented_piece, int orientation, int column,
+		    LastMoveInfo *last_move_info, int cancellable); /**< Called by board_drop_piece(). */
+  void (*update_column_heights)(Board *board);     /**< Called by board_update_column_heights(). */
 
   /**
-   * @name Information needed to cancel the last move.
+   * @name Memory
    */
-  uint16_t *previous_rows;  /**< The board state before the last move. */
-  int previous_wall_height; /**< The wall height (index of the first empty row) before the last move. */
+  size_t block_size;        /**< Size of the block containing the board and its arrays. */
 };
 
 /**
@@ -61,7 +102,10 @@ struct Board {
  * @{
  */
 Board *new_board(int width, int height, int allow_lines_after_overflow, int nb_pieces, Piece *pieces);
+size_t board_get_block_size(int width, int height, int nb_pieces, Piece *pieces);
+void board_init(Board *board, int width, int height, int allow_lines_after_overflow, int nb_pieces, Piece *pieces);
 Board *new_board_copy(const Board *board);
+void board_copy(Board *board, const Board *other);
 void free_board(Board *board);
 /**
  * @}
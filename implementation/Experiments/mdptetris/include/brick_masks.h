@@ -8,16 +8,60 @@
 #include <stdio.h>
 #include <stdint.h>
 
+/**
+ * Number of bits of a row: 16 (default), 32 or 64.
+ * A row holds the board width plus the 2 side borders, so the width
+ * of the board is at most MDPTETRIS_ROW_BITS - 2.
+ */
+#ifndef MDPTETRIS_ROW_BITS
+#define MDPTETRIS_ROW_BITS 16
+#endif
+
+#if MDPTETRIS_ROW_BITS == 16
+typedef uint16_t BoardRow;
+#define BOARD_ROW_POPCOUNT(row) __builtin_popcount(row)
+#elif MDPTETRIS_ROW_BITS == 32
+typedef uint32_t BoardRow;
+#define BOARD_ROW_POPCOUNT(row) __builtin_popcount(row)
+#elif MDPTETRIS_ROW_BITS == 64
+typedef uint64_t BoardRow;
+#define BOARD_ROW_POPCOUNT(row) __builtin_popcountll(row)
+#else
+#error "MDPTETRIS_ROW_BITS must be 16, 32 or 64"
+#endif
+
+/**
+ * Bit of cell i in a row, cell 0 being the most significant bit.
+ */
+#define BRICK_MASK(i) ((BoardRow) ((BoardRow) 1 << (MDPTETRIS_ROW_BITS - 1 - (i))))
+
+/**
+ * Empty row of a board of the given width: only the left border (cell 0)
+ * and the cells from the right border (cell width + 1) are set,
+ * for example 1000000000011111 for standard Tetris.
+ */
+#define BOARD_EMPTY_ROW(width) ((BoardRow) (BRICK_MASK(0) | ((BoardRow) ~(BoardRow) 0 >> ((width) + 1))))
+
+/**
+ * Full row, for any width.
+ */
+#define BOARD_FULL_ROW ((BoardRow) ~(BoardRow) 0)
+
+/**
+ * Maximum width of a board.
+ */
+#define BOARD_MAX_WIDTH (MDPTETRIS_ROW_BITS - 2)
+
 /**
  * Bit masks to represent the bricks on a row and the shape of each piece.
- * With this representation, a row state is stored on a single 16-bit integer.
- * A row size must not exceed 16 cells.
+ * With this representation, a row state is stored on a single integer
+ * (a BoardRow), brick_masks[i] being the bit of cell i from the left.
  * There is 12 cells in the row of a standard Tetris game (including the 2 side borders).
  * These bit fields are also used to represent the shape of the pieces.
  */
-extern const uint16_t brick_masks[];
-extern const uint16_t brick_masks_inv[];
+extern const BoardRow brick_masks[];
+extern const BoardRow brick_masks_inv[];
 
-void print_row(FILE *out, uint16_t row);
+void print_row(FILE *out, BoardRow row);
 
 #endif
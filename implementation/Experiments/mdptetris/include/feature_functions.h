@@ -21,6 +21,8 @@
 FeatureFunction *feature_function(FeatureID feature_id);
 void features_initialize(const FeaturePolicy *feature_policy);
 void features_exit(void);
+int feature_get_bounds(FeatureID feature_id, const Game *game, double *min_value, double *max_value);
+int feature_get_cost(FeatureID feature_id);
 /**
  * @}
  */
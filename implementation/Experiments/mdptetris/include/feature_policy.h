@@ -150,6 +150,11 @@ struct FeaturePolicy {
   RewardDescription reward_description; /**< Immediate reward function used for the decision */
   int gameover_evaluation;              /**< 1 if the value of a gameover state is computed
 					 * with the features, 0 if it is 0, -1 if it is -inf */
+  int lookahead_candidates;             /**< 0 to choose the moves with a one-ply search, or number of
+					 * best moves (by their one-ply value) searched with one more piece,
+					 * see features_get_best_action() */
+  int lazy_evaluation;                  /**< 1 to stop evaluating a move once it cannot be the best one,
+					 * see features_get_best_action() */
 };
 
 /**
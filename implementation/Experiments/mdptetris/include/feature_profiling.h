@@ -0,0 +1,46 @@
+/**
+ * @defgroup feature_profiling Feature profiling
+ * @ingroup api
+ * @brief Cost of each feature function
+ *
+ * When the library is compiled with \c FEATURE_PROFILING defined, evaluate_features()
+ * and get_feature_values() count the calls and the processor cycles spent in each
+ * feature function. The totals are printed on the standard error when the program exits.
+ * Without \c FEATURE_PROFILING, the features are called directly and this module costs nothing.
+ *
+ * @{
+ */
+#ifndef FEATURE_PROFILING_H
+#define FEATURE_PROFILING_H
+
+#include "types.h"
+#include "feature_policy.h"
+
+#ifdef FEATURE_PROFILING
+
+double feature_profiling_get_rating(const Feature *feature, Game *game);
+void feature_profiling_update_column_heights(Board *board);
+void feature_profiling_print(FILE *out);
+
+/**
+ * @brief Computes the value of a feature, counting its cost.
+ */
+#define FEATURE_RATING(feature, game) feature_profiling_get_rating(feature, game)
+
+/**
+ * @brief Updates the column heights before the features are computed, counting the cost.
+ */
+#define FEATURES_UPDATE_COLUMN_HEIGHTS(board) feature_profiling_update_column_heights(board)
+
+#else
+
+#define FEATURE_RATING(feature, game) ((feature)->get_feature_rating(game))
+#define FEATURES_UPDATE_COLUMN_HEIGHTS(board) board_update_column_heights(board)
+
+#endif
+
+#endif
+
+/**
+ * @}
+ */
@@ -16,6 +16,7 @@
 #include "board.h"
 #include "piece.h"
 #include "last_move_info.h"
+#include "random.h"
 
 /**
  * @brief Action decided by the player.
@@ -43,6 +44,29 @@ typedef struct PieceConfiguration {
   int nb_games;             /**< Number of games currently allocated that use this piece configuration. */
 } PieceConfiguration;
 
+/**
+ * @brief Counters of the work done in a game.
+ *
+ * The counters are not reset by game_reset(), so they accumulate over all
+ * the games played with the same Game object until game_reset_counters() is called.
+ */
+typedef struct GameCounters {
+  long nb_pieces;              /**< Number of pieces placed (moves that cannot be cancelled). */
+  long nb_afterstates;         /**< Number of afterstates generated (moves that can be cancelled,
+				* e.g. when a policy tries every move). */
+  long nb_lines;               /**< Number of lines removed by the pieces placed. */
+} GameCounters;
+
+/**
+ * @brief Information needed to cancel a move of a game.
+ *
+ * The board saves its own state, see BoardUndo.
+ */
+typedef struct GameUndo {
+  int score;                   /**< The score before the move. */
+  int previous_piece_index;    /**< The last piece placed before the move. */
+} GameUndo;
+
 /**
  * @brief A game.
  *
@@ -67,14 +91,35 @@ struct Game {
   Piece *current_piece;                   /**< The current piece falling. */
   int current_piece_index;                /**< Index of the current piece. */
   int current_piece_sequence_index;       /**< Current index in the sequence of pieces. */
-  
+  RandomGenerator *random_generator;      /**< Random stream of this game, or NULL to draw
+					   * the pieces from the global generator. */
+
   /**
    * @name Information about the previous state
    */
   int previous_piece_index;               /**< The last piece placed. */
   LastMoveInfo last_move_info;            /**< Information about the last move. */
+  GameUndo undo_log[BOARD_UNDO_DEPTH];    /**< Stack of the moves that can be cancelled. */
+  int undo_depth;                         /**< Number of moves in the stack. */
+
+  /**
+   * @name Statistics
+   */
+  GameCounters counters;                  /**< Work done since the last call to game_reset_counters(). */
 };
 
+/**
+ * @brief A saved game state.
+ *
+ * A snapshot is taken once and can then be restored many times into a game
+ * with the same board size and pieces (e.g. into the scratch game of each
+ * simulation of a search), without allocating anything.
+ */
+typedef struct GameSnapshot {
+  Game game;                              /**< The game fields when the snapshot was taken. */
+  Board *board;                           /**< Copy of the board. */
+} GameSnapshot;
+
 /**
  * @name Game creation and destruction
  *
@@ -90,6 +135,21 @@ void free_game(Game *game);
  * @}
  */
 
+/**
+ * @name Snapshots
+ *
+ * These functions save a game state and restore it later.
+ *
+ * @{
+ */
+GameSnapshot *new_game_snapshot(const Game *game);
+void game_save_snapshot(GameSnapshot *snapshot, const Game *game);
+void game_restore_snapshot(Game *game, const GameSnapshot *snapshot);
+void free_game_snapshot(GameSnapshot *snapshot);
+/**
+ * @}
+ */
+
 /**
  * @name Observation functions
  *
@@ -116,6 +176,8 @@ int game_drop_piece(Game *game, const Action *action, int cancellable);
 void game_cancel_last_move(Game *game);
 void game_set_current_piece_index(Game *game, int piece_index);
 void game_reset(Game *game);
+void game_set_seed(Game *game, unsigned long seed);
+void game_reset_counters(Game *game);
 void generate_next_piece(Game *game);
 /**
  * @}
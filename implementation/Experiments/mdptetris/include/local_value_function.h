@@ -0,0 +1,86 @@
+/**
+ * @defgroup local_value_function Local value function
+ * @ingroup api
+ * @brief Value function of the 5*5 board used by feature NEXT_LOCAL_VALUE_FUNCTION
+ *
+ * The table has one value per state of the small board (NB_STATES values).
+ * It can be read from the file saved by the value iteration program
+ * (a ValueIterationParameters structure followed by the values as doubles),
+ * which makes a private copy of the whole table in each process.
+ *
+ * It can also be stored in a mapped values file: a LocalValueFunctionHeader
+ * followed by the values, as doubles or as floats. Such a file is mapped
+ * read-only in memory, so loading it is immediate and all the processes
+ * of the machine share the same physical pages.
+ * A mapped values file can contain the values of the canonical states only
+ * (see get_canonical_state_code()), which halves its size: the state is then
+ * replaced by its canonical state when the value is read. The numbering of
+ * the canonical states (see compute_canonical_states()) is then stored after
+ * the values, so it is shared too instead of being computed by each process.
+ * Use <code>value_iteration values_file mapped_file [float]</code> to create it.
+ *
+ * @{
+ */
+#ifndef LOCAL_VALUE_FUNCTION_H
+#define LOCAL_VALUE_FUNCTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Identifies a mapped values file.
+ */
+#define LOCAL_VALUE_FUNCTION_MAGIC "MDPTLVF"
+
+/**
+ * @brief Version of the mapped values file format.
+ */
+#define LOCAL_VALUE_FUNCTION_VERSION 3
+
+/**
+ * @brief Header of a mapped values file.
+ *
+ * The values start right after the header (64 bytes), in the byte order of
+ * the machine that wrote the file. With the canonical states only, the
+ * numbering tables follow at \c tables_offset: NB_CANONICAL_TABLE_WORDS
+ * uint64_t words of bits, then NB_CANONICAL_TABLE_WORDS uint32_t ranks.
+ */
+typedef struct LocalValueFunctionHeader {
+  char magic[8];            /**< LOCAL_VALUE_FUNCTION_MAGIC */
+  uint32_t version;         /**< LOCAL_VALUE_FUNCTION_VERSION */
+  uint32_t byte_order;      /**< 0x01020304 written in the byte order of the file */
+  uint32_t value_size;      /**< sizeof(double) or sizeof(float) */
+  uint32_t width;           /**< width of the small board */
+  uint32_t height;          /**< height of the small board */
+  uint32_t canonical;       /**< 1 if only the canonical states are stored (0 in version 1,
+			     * requires version 3) */
+  uint64_t nb_states;       /**< number of values */
+  uint64_t tables_offset;   /**< offset of the numbering of the canonical states (64-byte aligned),
+			     * or 0 if all states are stored */
+  char padding[16];         /**< 0, so that the values are aligned on 64 bytes */
+} LocalValueFunctionHeader;
+
+/**
+ * @brief A loaded local value function.
+ *
+ * Exactly one of \c values and \c values_float is not \c NULL.
+ */
+typedef struct LocalValueFunction {
+  const double *values;     /**< the values, if stored as doubles */
+  const float *values_float;/**< the values, if stored as floats */
+  void *mapping;            /**< the mapped file, or NULL if the values were read in memory */
+  size_t mapped_size;       /**< size of the mapping */
+  int canonical;            /**< 1 if the values are indexed by the rank of the canonical states */
+  const uint64_t *canonical_bits;  /**< numbering of the canonical states in the mapping (if canonical) */
+  const uint32_t *canonical_ranks; /**< numbering of the canonical states in the mapping (if canonical) */
+} LocalValueFunction;
+
+LocalValueFunction *load_local_value_function(const char *mapped_file_name, const char *values_file_name);
+void free_local_value_function(LocalValueFunction *local_value_function);
+void save_mapped_local_value_function(const char *mapped_file_name, const double *values, int use_float, int canonical);
+
+#endif
+
+/**
+ * @}
+ */
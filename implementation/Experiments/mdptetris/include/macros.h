@@ -138,6 +138,29 @@
  */
 #define REALLOC(p, type, nb) if ((p = (type*) realloc(p, nb * sizeof(type))) == NULL) { DIE("MEMORY FULL\n"); }
 
+/**
+ * @brief Size of a cache line, the alignment of the blocks allocated by \ref MALLOC_ALIGNED.
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief Rounds a size in bytes up to a whole number of cache lines.
+ * @param size the size to round
+ */
+#define CACHE_LINE_ROUND(size) (((size) + CACHE_LINE_SIZE - 1) & ~((size_t) CACHE_LINE_SIZE - 1))
+
+/**
+ * @brief Allocates a block of memory aligned on a cache line.
+ *
+ * If there is not enough memory, the program stops on an error message.
+ * The block is freed with \ref FREE.
+ *
+ * @param p pointer to where the memory will be allocated
+ * @param type type of the data allocated
+ * @param size size of the block in bytes
+ */
+#define MALLOC_ALIGNED(p, type, size) if (posix_memalign((void**) &p, CACHE_LINE_SIZE, size) != 0) { DIE("MEMORY FULL\n"); }
+
 /**
  * @brief Copies some memory.
  * @param dst destination pointer
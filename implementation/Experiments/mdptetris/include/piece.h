@@ -4,7 +4,7 @@
  * @brief Tetris pieces
  *
  * This module handles the game pieces. A piece is composed by an array of orientations.
- * Each orientation is an array of rows, where each row is represented by a 16-bit integer.
+ * Each orientation is an array of rows, where each row is represented by a BoardRow integer.
  *
  * @{
  */
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "types.h"
+#include "brick_masks.h"
 
 /**
  * @brief A Tetris piece oriented in a specific direction.
@@ -21,14 +22,31 @@
 struct PieceOrientation {
   int width;                  /**< Width of the piece in this orientation. */
   int height;                 /**< Height of the piece in this orientation. */
-  uint16_t *bricks;           /**< Shape of the piece in this orientation
+  BoardRow *bricks;           /**< Shape of the piece in this orientation
                                * (array of size \c height where each element is a
-			       * 16-bit integer representing a row). */
+			       * BoardRow integer representing a row). */
   int *nb_full_cells_on_rows; /**< Number of full cells on each row (array of
 			       * size \c height where each element is the
 			       * number of full cells on a row. */
+  int nb_columns;             /**< Number of columns where the piece fits on the
+			       * widest board (BOARD_MAX_WIDTH - width + 1). */
+  BoardRow *placed_bricks;    /**< Shape of the piece placed on each column
+			       * (array of size \c nb_columns * \c height,
+			       * see PIECE_PLACED_BRICKS()). */
 };
 
+/**
+ * @brief Rows of a piece orientation placed on a column of the board.
+ *
+ * Row \c i of the result is <code>orientation->bricks[i] >> column</code>,
+ * precomputed by load_pieces().
+ *
+ * @param orientation the piece orientation
+ * @param column the column of the board, the first column is \c 1
+ */
+#define PIECE_PLACED_BRICKS(orientation, column) \
+  (&(orientation)->placed_bricks[((column) - 1) * (orientation)->height])
+
 /**
  * @brief A Tetris piece with its possible orientations.
  */
@@ -1,6 +1,12 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+/**
+ * A random number generator with its own stream, independent from the
+ * global generator.
+ */
+typedef struct RandomGenerator RandomGenerator;
+
 /**
  * Initializes the GSL random number generator.
  */
@@ -21,4 +27,34 @@ int random_uniform(int a, int b);
  */
 double random_gaussian(double mu, double sigma);
 
+/**
+ * Derives the seed of a child stream from the seed of its parent.
+ */
+unsigned long random_derive_seed(unsigned long parent_seed, unsigned long child_index);
+
+/**
+ * Creates a random number generator with its own stream.
+ */
+RandomGenerator *new_random_generator(unsigned long seed);
+
+/**
+ * Creates a copy of a random number generator, at the same position in the stream.
+ */
+RandomGenerator *new_random_generator_copy(const RandomGenerator *other);
+
+/**
+ * Frees a random number generator.
+ */
+void free_random_generator(RandomGenerator *generator);
+
+/**
+ * Restarts the stream of a random number generator with a new seed.
+ */
+void random_generator_set_seed(RandomGenerator *generator, unsigned long seed);
+
+/**
+ * Returns an integer number in [a,b[ from the stream of a random number generator.
+ */
+int random_generator_uniform(RandomGenerator *generator, int a, int b);
+
 #endif
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include "game.h"
 #include "macros.h"
+#include "brick_masks.h"
 #include "file_tools.h"
 
 /* Uncomment the following line for 4*5  */
@@ -21,7 +22,7 @@
 #define HEIGHT 5
 #define NB_STATES 1048576
 #define LAST_BITS_MASK 0x0000000F /* 4 bits */
-#define WEAK_BITS_SHIFT 11
+#define WEAK_BITS_SHIFT (MDPTETRIS_ROW_BITS - 1 - WIDTH)
 
 #else
 
@@ -29,7 +30,7 @@
 #define HEIGHT 5
 #define NB_STATES 33554432
 #define LAST_BITS_MASK 0x0000001F /* 5 bits */
-#define WEAK_BITS_SHIFT 10
+#define WEAK_BITS_SHIFT (MDPTETRIS_ROW_BITS - 1 - WIDTH)
 
 #endif
 
@@ -64,4 +65,28 @@ typedef struct OldValueIterationParameters {
 uint32_t get_game_code(Game *game);
 void set_game_state(Game *game, uint32_t state_code);
 
+/**
+ * Left-right symmetry of the states.
+ * A state and its mirror image have the same value when the set of pieces is
+ * symmetric (each piece has a mirror image in the set, like S and Z or J and L).
+ * Only the canonical state of each pair (the one with the smallest code) then needs
+ * to be stored: the canonical states are numbered from 0 to get_nb_canonical_states()-1.
+ */
+uint32_t get_mirror_state_code(uint32_t state_code);
+uint32_t get_canonical_state_code(uint32_t state_code);
+int pieces_are_symmetric(PieceConfiguration *piece_configuration);
+
+/**
+ * Number of words of each numbering table of the canonical states.
+ */
+#define NB_CANONICAL_TABLE_WORDS (NB_STATES / 64)
+
+void initialize_canonical_states(void);
+void exit_canonical_states(void);
+uint32_t get_nb_canonical_states(void);
+uint32_t get_canonical_state_rank(uint32_t canonical_state_code);
+uint32_t compute_canonical_states(uint64_t *bits, uint32_t *ranks);
+uint32_t get_canonical_state_rank_in_tables(const uint64_t *bits, const uint32_t *ranks,
+					    uint32_t canonical_state_code);
+
 #endif
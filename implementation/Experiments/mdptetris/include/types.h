@@ -19,6 +19,8 @@ typedef struct GamesStatistics GamesStatistics;
 typedef struct Strategy Strategy;
 typedef struct CommonParameters CommonParameters;
 typedef struct UctNode UctNode;
+typedef struct UctTable UctTable;
+typedef struct UctSearch UctSearch;
 
 /**
  * @brief Function type for a feature.
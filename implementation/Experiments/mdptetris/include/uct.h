@@ -3,9 +3,15 @@
 
 #include "types.h"
 
-UctNode *uct_node_new(Game *game, double (*heuristic)(Game *game));
-void uct_node_free(void *node);
-Action think(UctNode *root, const Game *game, double time,
+UctTable *uct_table_new(const Game *game, int max_nodes);
+void uct_table_free(UctTable *table);
+void uct_table_clear(UctTable *table);
+int uct_table_get_nb_nodes(const UctTable *table);
+UctNode *uct_table_get(UctTable *table, const Game *game);
+UctNode *uct_table_add(UctTable *table, Game *game, double (*heuristic)(Game *game));
+UctSearch *uct_search_new(const Game *game, int nb_threads, int max_nodes, unsigned long seed);
+void uct_search_free(UctSearch *search);
+Action think(UctSearch *search, const Game *game, double time,
 	     double (*value_estimator)(Game *game), double (*heuristic)(Game *game));
 
 #endif
@@ -8,10 +8,43 @@
 #include "brick_masks.h"
 #include <math.h>
 
+/*
+ * Private functions.
+ */
+static int get_max_piece_height(int nb_pieces, Piece *pieces);
+static void board_set_arrays(Board *board);
+static void board_set_functions(Board *board);
+static void board_save_rows(Board *board, int first_row, int top_row, int wall_height);
+static int board_remove_full_rows(Board *board, int destination, int *wall_height,
+				  const PieceOrientation *oriented_piece,
+				  BoardRow empty_row, BoardRow full_row, LastMoveInfo *last_move_info);
+
+/*
+ * Instances of board_template.h: the generic version and the
+ * specialized versions for the usual board sizes.
+ */
+#define BOARD_TEMPLATE(name) board_##name##_generic
+#define BOARD_TEMPLATE_WIDTH(board) ((board)->width)
+#define BOARD_TEMPLATE_HEIGHT(board) ((board)->height)
+#define BOARD_TEMPLATE_EMPTY_ROW(board) ((board)->empty_row)
+#include "board_template.h"
+
+#define BOARD_TEMPLATE(name) board_##name##_10x20
+#define BOARD_TEMPLATE_WIDTH(board) 10
+#define BOARD_TEMPLATE_HEIGHT(board) 20
+#define BOARD_TEMPLATE_EMPTY_ROW(board) BOARD_EMPTY_ROW(10)
+#include "board_template.h"
+
+#define BOARD_TEMPLATE(name) board_##name##_10x10
+#define BOARD_TEMPLATE_WIDTH(board) 10
+#define BOARD_TEMPLATE_HEIGHT(board) 10
+#define BOARD_TEMPLATE_EMPTY_ROW(board) BOARD_EMPTY_ROW(10)
+#include "board_template.h"
+
 /**
  * @brief Creates a new empty board.
  *
- * @param width board width (10 in standard Tetris; must be lower than or equal to 14)
+ * @param width board width (10 in standard Tetris; must be lower than or equal to BOARD_MAX_WIDTH)
  * @param height board height (20 in standard Tetris)
  * @param allow_lines_after_overflow 1 to enable the lines completion when the piece overflows
  * @param nb_pieces number of existing pieces (7 for standard Tetris)
@@ -21,40 +54,146 @@
  */
 Board *new_board(int width, int height, int allow_lines_after_overflow, int nb_pieces, Piece *pieces) {
   Board *board;
-  int i, j;
 
-  MALLOC(board, Board);
+  MALLOC_ALIGNED(board, Board, board_get_block_size(width, height, nb_pieces, pieces));
+  board_init(board, width, height, allow_lines_after_overflow, nb_pieces, pieces);
+
+  return board;
+}
+
+/**
+ * @brief Returns the size of the block needed to store a board and its arrays.
+ *
+ * This is the size to allocate to store a board inside another structure with board_init().
+ *
+ * @param width board width
+ * @param height board height
+ * @param nb_pieces number of existing pieces
+ * @param pieces array of existing pieces
+ * @return the size in bytes, a multiple of the cache line size
+ */
+size_t board_get_block_size(int width, int height, int nb_pieces, Piece *pieces) {
+  Board layout;
+
+  /* compute the layout of a board stored at any address */
+  layout.width = width;
+  layout.extended_height = height + get_max_piece_height(nb_pieces, pieces);
+  board_set_arrays(&layout);
+
+  return layout.block_size;
+}
+
+/**
+ * @brief Initializes an empty board in a block of memory.
+ *
+ * The block must have the size given by board_get_block_size() and be aligned
+ * on a cache line. new_board() allocates the block and calls this function.
+ *
+ * @param board the block where the board is stored
+ * @param width board width (10 in standard Tetris; must be lower than or equal to BOARD_MAX_WIDTH)
+ * @param height board height (20 in standard Tetris)
+ * @param allow_lines_after_overflow 1 to enable the lines completion when the piece overflows
+ * @param nb_pieces number of existing pieces (7 for standard Tetris)
+ * @param pieces array of existing pieces (\c nb_pieces elements)
+ * @see new_board(), board_get_block_size()
+ */
+void board_init(Board *board, int width, int height, int allow_lines_after_overflow, int nb_pieces, Piece *pieces) {
+
+  if (width > BOARD_MAX_WIDTH) {
+    DIE1("The board width must be lower than or equal to %d (see MDPTETRIS_ROW_BITS)\n", BOARD_MAX_WIDTH);
+  }
+
   board->width = width;
   board->height = height;
   board->allow_lines_after_overflow = allow_lines_after_overflow;
-  CALLOC(board->column_heights, int, width + 1);
 
   /* Compute an empty row, for example 1000000000011111 for standard Tetris.
    * Note that an empty row is not really empty because of the side borders.
    */
-  board->empty_row = brick_masks[0] | brick_masks[width+1];
-  for (i = width + 2; i < 16; i++) {
-    board->empty_row |= brick_masks[i];
-  }
-  board->full_row = 0xFFFF;
+  board->empty_row = BOARD_EMPTY_ROW(width);
+  board->full_row = BOARD_FULL_ROW;
   
   /* compute max_piece_height (maximum possible height of a piece) */
-  board->max_piece_height = 0;
+  board->max_piece_height = get_max_piece_height(nb_pieces, pieces);
+
+  board->extended_height = height + board->max_piece_height;
+
+  board_set_arrays(board);
+  board_set_functions(board);
+  memset(board->column_heights, 0, (width + 1) * sizeof(int));
+
+  /* make the rows empty */
+  board_reset(board);
+}
+
+/**
+ * @brief Returns the maximum height of a piece in any orientation.
+ */
+static int get_max_piece_height(int nb_pieces, Piece *pieces) {
+  int i, j, max_piece_height;
+
+  max_piece_height = 0;
   for (i = 0; i < nb_pieces; i++) {
     for (j = 0; j < pieces[i].nb_orientations; j++) {
-      board->max_piece_height = MAX(board->max_piece_height, pieces[i].orientations[j].height);
+      max_piece_height = MAX(max_piece_height, pieces[i].orientations[j].height);
     }
   }
 
-  board->extended_height = height + board->max_piece_height;
+  return max_piece_height;
+}
 
-  CALLOC(board->rows, uint16_t, board->extended_height);
-  CALLOC(board->previous_rows, uint16_t, board->extended_height);
+/**
+ * @brief Points the arrays of a board to their place in the block of the board
+ * and computes the size of the block.
+ *
+ * The block contains the board structure, the rows, the column heights,
+ * the undo log and the undo rows, each one starting on a cache line.
+ * The undo rows are last so that a copy can stop at the rows in use.
+ * This function is called again each time a board is copied to another block.
+ *
+ * @param board a board whose width and extended height are set
+ */
+static void board_set_arrays(Board *board) {
+  char *block;
+  size_t offset;
 
-  /* make the rows empty */
-  board_reset(board);
+  block = (char*) board;
+  offset = CACHE_LINE_ROUND(sizeof(Board));
 
-  return board;
+  board->rows = (BoardRow*) (block + offset);
+  offset += CACHE_LINE_ROUND(board->extended_height * sizeof(BoardRow));
+
+  board->column_heights = (int*) (block + offset);
+  offset += CACHE_LINE_ROUND((board->width + 1) * sizeof(int));
+
+  board->undo_log = (BoardUndo*) (block + offset);
+  offset += CACHE_LINE_ROUND(BOARD_UNDO_DEPTH * sizeof(BoardUndo));
+
+  board->undo_rows = (BoardRow*) (block + offset);
+  offset += CACHE_LINE_ROUND(BOARD_UNDO_DEPTH * board->extended_height * sizeof(BoardRow));
+
+  board->block_size = offset;
+}
+
+/**
+ * @brief Chooses the implementation of the functions depending on the board size.
+ *
+ * The usual sizes (10x20, and 10x10 for the evaluation boards) have their own
+ * instance of board_template.h, the other sizes use the generic one.
+ */
+static void board_set_functions(Board *board) {
+  if (board->width == 10 && board->height == 20) {
+    board->drop_piece = board_drop_piece_10x20;
+    board->update_column_heights = board_update_column_heights_10x20;
+  }
+  else if (board->width == 10 && board->height == 10) {
+    board->drop_piece = board_drop_piece_10x10;
+    board->update_column_heights = board_update_column_heights_10x10;
+  }
+  else {
+    board->drop_piece = board_drop_piece_generic;
+    board->update_column_heights = board_update_column_heights_generic;
+  }
 }
 
 /**
@@ -63,19 +202,30 @@ Board *new_board(int width, int height, int allow_lines_after_overflow, int nb_p
 Board *new_board_copy(const Board *other) {
   
   Board *board;
-  MALLOC(board, Board);
-  *board = *other;
 
-  CALLOC(board->rows, uint16_t, board->extended_height);
-  MEMCPY(board->rows, other->rows, uint16_t, board->extended_height);
+  MALLOC_ALIGNED(board, Board, other->block_size);
+  board_copy(board, other);
 
-  CALLOC(board->previous_rows, uint16_t, board->extended_height);
-  MEMCPY(board->previous_rows, other->previous_rows, uint16_t, board->extended_height);
+  return board;
+}
 
-  CALLOC(board->column_heights, int, board->width + 1);
-  MEMCPY(board->column_heights, other->column_heights, int, board->width + 1);
+/**
+ * @brief Copies the state of a board into another board of the same size.
+ *
+ * Unlike new_board_copy(), nothing is allocated: the block of \c other
+ * is copied at once into the block of \c board, except the undo rows
+ * that are not in use. The moves of \c other can be cancelled on the copy.
+ *
+ * @param board the board to change
+ * @param other the board to copy
+ * @see new_board_copy()
+ */
+void board_copy(Board *board, const Board *other) {
+  size_t undo_rows_offset;
 
-  return board;
+  undo_rows_offset = (const char*) other->undo_rows - (const char*) other;
+  memcpy(board, other, undo_rows_offset + other->nb_undo_rows * sizeof(BoardRow));
+  board_set_arrays(board);
 }
 
 /**
@@ -85,9 +235,6 @@ Board *new_board_copy(const Board *other) {
  * @see new_board()
  */
 void free_board(Board *board) {
-  FREE(board->rows);
-  FREE(board->previous_rows);
-  FREE(board->column_heights);
   FREE(board);
 }
 
@@ -112,129 +259,7 @@ void free_board(Board *board) {
  */
 int board_drop_piece(Board *board, PieceOrientation *oriented_piece, int orientation, int column,
 		     LastMoveInfo *last_move_info, int cancellable) {
-  int i, i_stop, j;
-  int destination;              /* index of the row where the bottom part of the piece is put */
-  int destination_top;          /* 1 + (index of the highest row occupied by the piece once it is put) */           
-  uint16_t *board_rows;
-  uint16_t *piece_bricks;
-  uint16_t empty_row, full_row;
-  int collision;
-  int piece_height, piece_width;
-  int current_row;
-  int removed_lines;
-  int wall_height;
-
-  board_rows = board->rows;
-  empty_row = board->empty_row;
-  full_row = board->full_row;
-  piece_bricks = oriented_piece->bricks;
-  wall_height = board->wall_height;
-  removed_lines = 0;
-
-  /* backup the board if necessary */
-  if (cancellable) {
-    MEMCPY(board->previous_rows, board_rows, uint16_t, board->extended_height);
-    board->previous_wall_height = wall_height;
-  }
-
-  /* initialize last_move_info */
-  if (last_move_info != NULL) {
-    last_move_info->eliminated_bricks_in_last_piece = 0;
-  }
-  
-  /* we will search the lowest available row for the piece (variable destination)
-     wall_height is the index of the lowest empty row so we start from there and look downwards */
-  piece_height = oriented_piece->height;
-  piece_width = oriented_piece->width;
-  destination = wall_height;
-  
-  collision = 0;
-  while (destination >= 0 && !collision) { /* descend while no collision */
-  
-    /* detect collisions on each row occupied by the piece */
-    current_row = destination;
-
-    for (i = 0; i < piece_height && !collision; i++, current_row++) {
-
-      /* debug info
-      if (destination + i >= board->height || destination < 0) {
-	printf("on déborde ! destination = %d, i = %d, wall_height = %d, piece_height = %d\n",
-	       destination, i, wall_height, piece_height);
-	board_print(stdout, board);
-      }
-      */
-
-      collision = board_rows[current_row] & (piece_bricks[i] >> column);
-    }
-    if (!collision) {
-      destination--;
-    }
-  }
-  destination++;
-  /* now destination is the index of the row where the bottom part of the piece is put */
-  
-  destination_top = destination + piece_height;
-
-  /* update wall_height */
-  wall_height = MAX(wall_height, destination_top);
-  
-  /* update the board */
-  for (i = 0; i < piece_height; i++) {
-    board_rows[destination + i] |= piece_bricks[i] >> column;
-  }
-
-  /* remove full rows */
-
-  if (destination_top <= board->height || board->allow_lines_after_overflow) {
-
-    i = 0;
-    i_stop = piece_height;
-    while (i < i_stop) {
-      current_row = destination + i;
-
-      /* check whether the row is full */
-      if (board_rows[current_row] == full_row) {
-	/* move the upper rows downwards */
-	j = current_row;
-	while (j < wall_height - 1 && board_rows[j] != empty_row) {
-	  board_rows[j] = board_rows[j+1];
-	  j++;
-	}
-      
-	/* clear the last row */
-	board_rows[j] = empty_row;
-	wall_height--;
-
-	/* update last_move_info */
-	if (last_move_info != NULL) {
-	  /* 	printf("updating eliminated bricks: row %d is full\n", current_row); */
-	  /* 	printf("corresponds to row %d in the piece\n", i + removed_lines); */
-	  /* 	printf("nb cells: %d\n", oriented_piece->nb_full_cells_on_rows[i + removed_lines]); */
-	  /* 	print_piece_orientation(stdout, oriented_piece); */
-	  last_move_info->eliminated_bricks_in_last_piece += oriented_piece->nb_full_cells_on_rows[i + removed_lines];
-	}
-
-	removed_lines++;
-	i_stop--;
-      }
-      else {
-	i++;
-      }
-    }
-  }
-
-  /* update last_move_info */
-  if (last_move_info != NULL) {
-    last_move_info->removed_lines = removed_lines;
-    last_move_info->landing_height_bottom = destination;
-    last_move_info->column = column;
-    last_move_info->orientation = orientation;
-    last_move_info->oriented_piece = oriented_piece;
-  }
-
-  board->wall_height = wall_height;
-  
-  return removed_lines;
+  return board->drop_piece(board, oriented_piece, orientation, column, last_move_info, cancellable);
 }
 
 
@@ -257,12 +282,12 @@ int board_drop_piece(Board *board, PieceOrientation *oriented_piece, int orienta
  */
 int board_drop_piece_rlc(Board *board, Piece *pieces, int piece_index, int desired_orientation, int desired_column,
 		     LastMoveInfo *last_move_info, int cancellable) {
-  int i, i_stop, j;
+  int i;
   int destination;              /* index of the row where the bottom part of the piece is put */
   int destination_top;          /* 1 + (index of the highest row occupied by the piece once it is put) */           
-  uint16_t *board_rows;
-  uint16_t *piece_bricks;
-  uint16_t empty_row, full_row;
+  BoardRow *board_rows;
+  BoardRow *piece_bricks;
+  BoardRow empty_row, full_row;
   int collision;
   int piece_height, piece_width;
   int current_row;
@@ -293,12 +318,6 @@ int board_drop_piece_rlc(Board *board, Piece *pieces, int piece_index, int desir
   wall_height = board->wall_height;
   removed_lines = 0;
 
-  /* backup the board if necessary */
-  if (cancellable) {
-    MEMCPY(board->previous_rows, board_rows, uint16_t, board->extended_height);
-    board->previous_wall_height = wall_height;
-  }
-
   /* initialize last_move_info */
   last_move_info->eliminated_bricks_in_last_piece = 0;   
   last_move_info->nb_steps = 2;  
@@ -335,7 +354,7 @@ int board_drop_piece_rlc(Board *board, Piece *pieces, int piece_index, int desir
     /* detect collisions on each row occupied by the piece */
     current_row = destination;
     for (i = 0; i < piece_height && !collision; i++, current_row++) {
-      collision = board_rows[current_row] & (piece_bricks[i] >> column);      
+      collision = (board_rows[current_row] & (piece_bricks[i] >> column)) != 0;      
     }
     if (!collision) {
 
@@ -427,7 +446,7 @@ int board_drop_piece_rlc(Board *board, Piece *pieces, int piece_index, int desir
 	} else {
 	  current_row = destination;
 	  for (i = 0; (i<piece_height) && !collision; i++, current_row++) { /* collision with other pieces */
-	    collision = board_rows[current_row] & (piece_bricks[i] >> column);      
+	    collision = (board_rows[current_row] & (piece_bricks[i] >> column)) != 0;      
 	  }
 	}
 	
@@ -456,6 +475,11 @@ int board_drop_piece_rlc(Board *board, Piece *pieces, int piece_index, int desir
   
   destination_top = destination + piece_height;
 
+  /* save the rows that will change if necessary */
+  if (cancellable) {
+    board_save_rows(board, destination, destination_top, wall_height);
+  }
+
   /* update wall_height */
   wall_height = MAX(wall_height, destination_top);
   
@@ -472,40 +496,8 @@ int board_drop_piece_rlc(Board *board, Piece *pieces, int piece_index, int desir
 
   if (destination_top <= board->height || board->allow_lines_after_overflow) {
 
-    i = 0;
-    i_stop = piece_height;
-    while (i < i_stop) {
-      current_row = destination + i;
-
-      /* check whether the row is full */
-      if (board_rows[current_row] == full_row) {
-	/* move the upper rows downwards */
-	j = current_row;
-	while (j < wall_height - 1 && board_rows[j] != empty_row) {
-	  board_rows[j] = board_rows[j+1];
-	  j++;
-	}
-      
-	/* clear the last row */
-	board_rows[j] = empty_row;
-	wall_height--;
-
-	/* update last_move_info */
-	if (last_move_info != NULL) {
-	  /* 	printf("updating eliminated bricks: row %d is full\n", current_row); */
-	  /* 	printf("corresponds to row %d in the piece\n", i + removed_lines); */
-	  /* 	printf("nb cells: %d\n", oriented_piece->nb_full_cells_on_rows[i + removed_lines]); */
-	  /* 	print_piece_orientation(stdout, oriented_piece); */
-	  last_move_info->eliminated_bricks_in_last_piece += oriented_piece->nb_full_cells_on_rows[i + removed_lines];
-	}
-
-	removed_lines++;
-	i_stop--;
-      }
-      else {
-	i++;
-      }
-    }
+    removed_lines = board_remove_full_rows(board, destination, &wall_height, oriented_piece,
+					   empty_row, full_row, last_move_info);
   }
 
   /* update last_move_info */
@@ -544,9 +536,9 @@ int board_drop_piece_fancy(Board *board, PieceOrientation *oriented_piece, int o
   int i, i_stop, j, k;
   int destination;              /* index of the row where the bottom part of the piece is put */
   int destination_top;          /* 1 + (index of the highest row occupied by the piece once it is put) */           
-  uint16_t *board_rows;
-  uint16_t *piece_bricks;
-  uint16_t empty_row, full_row;
+  BoardRow *board_rows;
+  BoardRow *piece_bricks;
+  BoardRow empty_row, full_row;
   int collision;
   int piece_height, piece_width;
   int current_row;
@@ -560,12 +552,6 @@ int board_drop_piece_fancy(Board *board, PieceOrientation *oriented_piece, int o
   wall_height = board->wall_height;
   removed_lines = 0;
 
-  /* backup the board if necessary */
-  if (cancellable) {
-    MEMCPY(board->previous_rows, board_rows, uint16_t, board->extended_height);
-    board->previous_wall_height = wall_height;
-  }
-
   /* initialize last_move_info */
   if (last_move_info != NULL) {
     last_move_info->eliminated_bricks_in_last_piece = 0;
@@ -593,7 +579,7 @@ int board_drop_piece_fancy(Board *board, PieceOrientation *oriented_piece, int o
       }
       */
 
-      collision = board_rows[current_row] & (piece_bricks[i] >> column);
+      collision = (board_rows[current_row] & (piece_bricks[i] >> column)) != 0;
     }
     if (!collision) {
       destination--;
@@ -604,6 +590,11 @@ int board_drop_piece_fancy(Board *board, PieceOrientation *oriented_piece, int o
   
   destination_top = destination + piece_height;
 
+  /* save the rows that will change if necessary */
+  if (cancellable) {
+    board_save_rows(board, destination, destination_top, wall_height);
+  }
+
   /* update wall_height */
   wall_height = MAX(wall_height, destination_top);
   
@@ -639,40 +630,8 @@ int board_drop_piece_fancy(Board *board, PieceOrientation *oriented_piece, int o
       i++;
     }
 
-    i = 0;
-    i_stop = piece_height;
-    while (i < i_stop) {
-      current_row = destination + i;
-
-      /* check whether the row is full */
-      if (board_rows[current_row] == full_row) {
-	/* move the upper rows downwards */
-	j = current_row;
-	while (j < wall_height - 1 && board_rows[j] != empty_row) {
-	  board_rows[j] = board_rows[j+1];	  
-	  j++;
-	}
-      
-	/* clear the last row */
-	board_rows[j] = empty_row;
-	wall_height--;
-
-	/* update last_move_info */
-	if (last_move_info != NULL) {
-	  /* 	printf("updating eliminated bricks: row %d is full\n", current_row); */
-	  /* 	printf("corresponds to row %d in the piece\n", i + removed_lines); */
-	  /* 	printf("nb cells: %d\n", oriented_piece->nb_full_cells_on_rows[i + removed_lines]); */
-	  /* 	print_piece_orientation(stdout, oriented_piece); */
-	  last_move_info->eliminated_bricks_in_last_piece += oriented_piece->nb_full_cells_on_rows[i + removed_lines];
-	}
-
-	removed_lines++;
-	i_stop--;
-      }
-      else {
-	i++;
-      }
-    }
+    removed_lines = board_remove_full_rows(board, destination, &wall_height, oriented_piece,
+					   empty_row, full_row, last_move_info);
   }
 
   /* update last_move_info */
@@ -694,22 +653,137 @@ int board_drop_piece_fancy(Board *board, PieceOrientation *oriented_piece, int o
 
 
 
+/**
+ * @brief Removes the full rows after a piece was put on the board.
+ *
+ * Only the rows of the piece can be full. They are removed in one pass:
+ * the other rows of the piece are compacted downwards, then the rows above
+ * the piece are moved down at once and the top rows are emptied.
+ *
+ * @param board the board
+ * @param destination index of the row where the bottom part of the piece was put
+ * @param wall_height the wall height with the piece, updated with the removed rows
+ * @param oriented_piece the oriented piece put
+ * @param empty_row the empty row of this board
+ * @param full_row the full row of this board
+ * @param last_move_info if not \c NULL, receives the number of cells of the piece
+ * in the removed rows
+ * @return the number of removed rows
+ */
+static int board_remove_full_rows(Board *board, int destination, int *wall_height,
+				  const PieceOrientation *oriented_piece,
+				  BoardRow empty_row, BoardRow full_row, LastMoveInfo *last_move_info) {
+  int i, piece_height, removed_lines, eliminated_bricks, current_row;
+  BoardRow *board_rows;
+
+  board_rows = board->rows;
+  piece_height = oriented_piece->height;
+
+  /* find the first full row, most moves have none */
+  for (i = 0; i < piece_height && board_rows[destination + i] != full_row; i++);
+  if (i == piece_height) {
+    return 0;
+  }
+
+  /* compact the rows of the piece: current_row is the next row to fill */
+  current_row = destination + i;
+  removed_lines = 0;
+  eliminated_bricks = 0;
+  for (; i < piece_height; i++) {
+    if (board_rows[destination + i] == full_row) {
+      removed_lines++;
+      eliminated_bricks += oriented_piece->nb_full_cells_on_rows[i];
+    }
+    else {
+      board_rows[current_row++] = board_rows[destination + i];
+    }
+  }
+
+  /* move the rows above the piece downwards */
+  i = destination + piece_height;
+  if (i < *wall_height) {
+    memmove(&board_rows[current_row], &board_rows[i], (*wall_height - i) * sizeof(BoardRow));
+  }
+
+  /* clear the top rows */
+  *wall_height -= removed_lines;
+  for (i = *wall_height; i < *wall_height + removed_lines; i++) {
+    board_rows[i] = empty_row;
+  }
+
+  if (last_move_info != NULL) {
+    last_move_info->eliminated_bricks_in_last_piece = eliminated_bricks;
+  }
+
+  return removed_lines;
+}
+
+/**
+ * @brief Saves the rows that a move will change, so that the move can be cancelled.
+ *
+ * The piece is put from \c first_row to \c top_row and the full rows
+ * removed afterwards are below the wall, so only the rows from \c first_row
+ * to the top of the wall (or of the piece) change.
+ *
+ * @param board the board, before the move
+ * @param first_row index of the row where the bottom part of the piece will be put
+ * @param top_row 1 + index of the highest row of the piece
+ * @param wall_height the wall height before the move
+ * @see board_cancel_last_move()
+ */
+static void board_save_rows(Board *board, int first_row, int top_row, int wall_height) {
+  BoardUndo *undo;
+  BoardRow *saved_rows, *rows;
+  int i, nb_rows;
+
+  if (board->undo_depth == BOARD_UNDO_DEPTH) {
+    DIE1("Cannot drop more than %d nested cancellable pieces (see BOARD_UNDO_DEPTH)", BOARD_UNDO_DEPTH);
+  }
+
+  nb_rows = MAX(wall_height, top_row) - first_row;
+
+  undo = &board->undo_log[board->undo_depth++];
+  undo->first_row = first_row;
+  undo->nb_rows = nb_rows;
+  undo->wall_height = wall_height;
+
+  /* a few rows in general: a loop is faster than memcpy() */
+  saved_rows = &board->undo_rows[board->nb_undo_rows];
+  rows = &board->rows[first_row];
+  for (i = 0; i < nb_rows; i++) {
+    saved_rows[i] = rows[i];
+  }
+  board->nb_undo_rows += nb_rows;
+}
+
 /**
  * @brief Removes the last dropped piece and restores the board state.
  *
  * This is possible only if cancellable was set to 1 when you called
- * board_drop_piece().
+ * board_drop_piece(). The moves are cancelled in the reverse order:
+ * up to BOARD_UNDO_DEPTH cancellable pieces can be dropped before
+ * they are cancelled.
  *
  * @param board the board
  * @see board_drop_piece()
  */
 void board_cancel_last_move(Board *board) {
-  uint16_t *tmp_rows;
-  
-  tmp_rows = board->rows;
-  board->rows = board->previous_rows;
-  board->previous_rows = tmp_rows;
-  board->wall_height = board->previous_wall_height;
+  BoardUndo *undo;
+  BoardRow *saved_rows, *rows;
+  int i;
+
+  if (board->undo_depth == 0) {
+    DIE("No move to cancel");
+  }
+
+  undo = &board->undo_log[--board->undo_depth];
+  board->nb_undo_rows -= undo->nb_rows;
+  saved_rows = &board->undo_rows[board->nb_undo_rows];
+  rows = &board->rows[undo->first_row];
+  for (i = 0; i < undo->nb_rows; i++) {
+    rows[i] = saved_rows[i];
+  }
+  board->wall_height = undo->wall_height;
 }
 
 /**
@@ -722,6 +796,8 @@ void board_reset(Board *board) {
     board->rows[i] = board->empty_row;
   }
   board->wall_height = 0;
+  board->undo_depth = 0;
+  board->nb_undo_rows = 0;
 }
 
 /**
@@ -764,34 +840,7 @@ int board_get_column_height(Board *board, int column) {
  * @see board_get_column_height()
  */
 void board_update_column_heights(Board *board) {
-  int i, j, board_width, wall_height, *p_column_height;
-  uint16_t *board_rows, column_mask;
-
-  board_rows = board->rows;
-  board_width = board->width;
-  wall_height = board->wall_height - 1;
-  p_column_height = &board->column_heights[1];
-
-  /* for each column */
-  for (j = 1; j <= board_width; j++, p_column_height++) {
-    column_mask = brick_masks[j];
-    *p_column_height = 0;
-    for (i = wall_height; i >= 0; i--) {
-      if (board_rows[i] & column_mask) {
-	*p_column_height = i + 1;
-	break;
-      }
-    }
-  }
-  
-  /* debug */
-/*   printf("\n-------- Updating column heights -----------\n"); */
-/*   print_board(stdout, board); */
-/*   for (j = 1; j <= board_width; j++) { */
-/*     printf("column %d: height = %d\n", j, board->column_heights[j]); */
-/*   } */
-/*   getchar(); */
-
+  board->update_column_heights(board);
 }
 
 /**
@@ -0,0 +1,142 @@
+/*
+ * Template of the board functions that depend on the board size.
+ *
+ * This file is included by board.c once for each specialized board size,
+ * and once for the generic version, with the following macros defined:
+ * - BOARD_TEMPLATE(name): name of the function instantiated for this size
+ * - BOARD_TEMPLATE_WIDTH(board), BOARD_TEMPLATE_HEIGHT(board): the board size,
+ *   constants for a specialized size or the fields of the board otherwise
+ * - BOARD_TEMPLATE_EMPTY_ROW(board): the empty row for this width
+ *
+ * With constant sizes, the compiler unrolls the loops on the columns and
+ * keeps the masks in registers. The macros are undefined at the end of the file.
+ */
+
+static int BOARD_TEMPLATE(drop_piece)(Board *board, PieceOrientation *oriented_piece, int orientation, int column,
+				      LastMoveInfo *last_move_info, int cancellable) {
+  int i;
+  int destination;              /* index of the row where the bottom part of the piece is put */
+  int destination_top;          /* 1 + (index of the highest row occupied by the piece once it is put) */           
+  BoardRow *board_rows;
+  const BoardRow *piece_bricks;
+  BoardRow empty_row, full_row;
+  int collision;
+  int piece_height;
+  int current_row;
+  int removed_lines;
+  int wall_height;
+
+  board_rows = board->rows;
+  empty_row = BOARD_TEMPLATE_EMPTY_ROW(board);
+  full_row = BOARD_FULL_ROW;
+  piece_bricks = PIECE_PLACED_BRICKS(oriented_piece, column);
+  wall_height = board->wall_height;
+  removed_lines = 0;
+
+  /* initialize last_move_info */
+  if (last_move_info != NULL) {
+    last_move_info->eliminated_bricks_in_last_piece = 0;
+  }
+  
+  /* we will search the lowest available row for the piece (variable destination)
+     wall_height is the index of the lowest empty row so we start from there and look downwards */
+  piece_height = oriented_piece->height;
+  destination = wall_height;
+  
+  collision = 0;
+  while (destination >= 0 && !collision) { /* descend while no collision */
+  
+    /* detect collisions on each row occupied by the piece */
+    current_row = destination;
+
+    for (i = 0; i < piece_height && !collision; i++, current_row++) {
+
+      /* debug info
+      if (destination + i >= board->height || destination < 0) {
+	printf("on déborde ! destination = %d, i = %d, wall_height = %d, piece_height = %d\n",
+	       destination, i, wall_height, piece_height);
+	board_print(stdout, board);
+      }
+      */
+
+      collision = (board_rows[current_row] & piece_bricks[i]) != 0;
+    }
+    if (!collision) {
+      destination--;
+    }
+  }
+  destination++;
+  /* now destination is the index of the row where the bottom part of the piece is put */
+  
+  destination_top = destination + piece_height;
+
+  /* save the rows that will change if necessary */
+  if (cancellable) {
+    board_save_rows(board, destination, destination_top, wall_height);
+  }
+
+  /* update wall_height */
+  wall_height = MAX(wall_height, destination_top);
+  
+  /* update the board */
+  for (i = 0; i < piece_height; i++) {
+    board_rows[destination + i] |= piece_bricks[i];
+  }
+
+  /* remove full rows */
+
+  if (destination_top <= BOARD_TEMPLATE_HEIGHT(board) || board->allow_lines_after_overflow) {
+
+    removed_lines = board_remove_full_rows(board, destination, &wall_height, oriented_piece,
+					   empty_row, full_row, last_move_info);
+  }
+
+  /* update last_move_info */
+  if (last_move_info != NULL) {
+    last_move_info->removed_lines = removed_lines;
+    last_move_info->landing_height_bottom = destination;
+    last_move_info->column = column;
+    last_move_info->orientation = orientation;
+    last_move_info->oriented_piece = oriented_piece;
+  }
+
+  board->wall_height = wall_height;
+  
+  return removed_lines;
+}
+
+static void BOARD_TEMPLATE(update_column_heights)(Board *board) {
+  int i, j, board_width, wall_height, *p_column_height;
+  BoardRow *board_rows, column_mask;
+
+  board_rows = board->rows;
+  board_width = BOARD_TEMPLATE_WIDTH(board);
+  wall_height = board->wall_height - 1;
+  p_column_height = &board->column_heights[1];
+
+  /* for each column */
+  for (j = 1; j <= board_width; j++, p_column_height++) {
+    column_mask = brick_masks[j];
+    *p_column_height = 0;
+    for (i = wall_height; i >= 0; i--) {
+      if (board_rows[i] & column_mask) {
+	*p_column_height = i + 1;
+	break;
+      }
+    }
+  }
+  
+  /* debug */
+/*   printf("\n-------- Updating column heights -----------\n"); */
+/*   print_board(stdout, board); */
+/*   for (j = 1; j <= board_width; j++) { */
+/*     printf("column %d: height = %d\n", j, board->column_heights[j]); */
+/*   } */
+/*   getchar(); */
+
+}
+
+#undef BOARD_TEMPLATE
+#undef BOARD_TEMPLATE_WIDTH
+#undef BOARD_TEMPLATE_HEIGHT
+#undef BOARD_TEMPLATE_EMPTY_ROW
@@ -5,52 +5,54 @@
 #include "config.h"
 #include "brick_masks.h"
 
-const uint16_t brick_masks[] = {
-  0x8000, /* X............... */
-  0x4000, /* .X.............. */
-  0x2000, /* ..X............. */
-  0x1000, /* etc */
-  0x0800,
-  0x0400,
-  0x0200,
-  0x0100,
-  0x0080,
-  0x0040,
-  0x0020,
-  0x0010,
-  0x0008,
-  0x0004,
-  0x0002, /* ..............X. */
-  0x0001  /* ...............X */
+#define BRICK_MASKS_8(i) BRICK_MASK(i), BRICK_MASK(i + 1), BRICK_MASK(i + 2), BRICK_MASK(i + 3), \
+    BRICK_MASK(i + 4), BRICK_MASK(i + 5), BRICK_MASK(i + 6), BRICK_MASK(i + 7)
+
+#define BRICK_MASKS_INV_8(i) (BoardRow) ~BRICK_MASK(i), (BoardRow) ~BRICK_MASK(i + 1), \
+    (BoardRow) ~BRICK_MASK(i + 2), (BoardRow) ~BRICK_MASK(i + 3), \
+    (BoardRow) ~BRICK_MASK(i + 4), (BoardRow) ~BRICK_MASK(i + 5), \
+    (BoardRow) ~BRICK_MASK(i + 6), (BoardRow) ~BRICK_MASK(i + 7)
+
+/* for 16 bits: 0x8000 (X...............), 0x4000 (.X..............), etc */
+const BoardRow brick_masks[] = {
+  BRICK_MASKS_8(0),
+  BRICK_MASKS_8(8)
+#if MDPTETRIS_ROW_BITS >= 32
+  , BRICK_MASKS_8(16),
+  BRICK_MASKS_8(24)
+#endif
+#if MDPTETRIS_ROW_BITS >= 64
+  , BRICK_MASKS_8(32),
+  BRICK_MASKS_8(40),
+  BRICK_MASKS_8(48),
+  BRICK_MASKS_8(56)
+#endif
 };
 
-const uint16_t brick_masks_inv[] = {
-   0x7FFF, /* .XXXXXXXXXXXXXXX */
-  ~0x4000, /* X.XXXXXXXXXXXXXX */
-  ~0x2000, /* XX.XXXXXXXXXXXXX */
-  ~0x1000, /* etc */
-  ~0x0800,
-  ~0x0400,
-  ~0x0200,
-  ~0x0100,
-  ~0x0080,
-  ~0x0040,
-  ~0x0020,
-  ~0x0010,
-  ~0x0008,
-  ~0x0004,
-  ~0x0002, /* XXXXXXXXXXXXXX.X */
-  ~0x0001  /* XXXXXXXXXXXXXXX. */
+/* for 16 bits: 0x7FFF (.XXXXXXXXXXXXXXX), ~0x4000 (X.XXXXXXXXXXXXXX), etc */
+const BoardRow brick_masks_inv[] = {
+  BRICK_MASKS_INV_8(0),
+  BRICK_MASKS_INV_8(8)
+#if MDPTETRIS_ROW_BITS >= 32
+  , BRICK_MASKS_INV_8(16),
+  BRICK_MASKS_INV_8(24)
+#endif
+#if MDPTETRIS_ROW_BITS >= 64
+  , BRICK_MASKS_INV_8(32),
+  BRICK_MASKS_INV_8(40),
+  BRICK_MASKS_INV_8(48),
+  BRICK_MASKS_INV_8(56)
+#endif
 };
 
 /**
- * Prints the 16 bits of a row into a file.
+ * Prints the bits of a row into a file.
  * @param out the file to write
  * @param row the row
  */
-void print_row(FILE *out, uint16_t row) {
+void print_row(FILE *out, BoardRow row) {
   int i;
-  for (i = 0; i < 16; i++) {
+  for (i = 0; i < MDPTETRIS_ROW_BITS; i++) {
     if (row & brick_masks[i]) {
       fprintf(out, "X");
     }
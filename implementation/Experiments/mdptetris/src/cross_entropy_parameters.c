@@ -416,6 +416,8 @@ void cross_entropy_load_feature_policy(CrossEntropyParameters *parameters) {
   parameters->feature_policy.features = features;
   parameters->feature_policy.nb_features = nb_features;
   parameters->feature_policy.update_column_heights_needed = update_column_heights_needed;
+  parameters->feature_policy.lookahead_candidates = 0;
+  parameters->feature_policy.lazy_evaluation = 0;
 }
 
 /**
@@ -4,18 +4,33 @@
 #include "feature_policy.h"
 #include "game.h"
 #include "simple_tetris.h"
+#include "local_value_function.h"
 #include "brick_masks.h"
 #include "macros.h"
 
+#if MDPTETRIS_ROW_BITS == 16
 /**
  * @brief Number of possible states on a single row.
  *
- * A row is represented by a 16-bit integer so there are
+ * With 16-bit rows (MDPTETRIS_ROW_BITS == 16) there are
  * 2^16 possible rows, even if many of them will never occur
- * because some bits are always 1.
+ * because some bits are always 1. The number of transitions and
+ * of bits 1 of a row are then read from tables indexed by the row.
  */
 #define NB_POSSIBLE_ROWS 65536
 
+#define ROW_TRANSITIONS(row) row_transitions[row]
+#define ROW_BITS_1(row) bits_1[row]
+
+#else
+/* Wider rows are too large for the tables: the transitions of a row are
+ * the bits 1 of the row XOR the row shifted by one cell (ignoring the
+ * last cell, which has no right neighbour) */
+#define ROW_TRANSITIONS(row) BOARD_ROW_POPCOUNT((BoardRow) (((row) ^ ((row) << 1)) & ~(BoardRow) 1))
+#define ROW_BITS_1(row) BOARD_ROW_POPCOUNT(row)
+
+#endif
+
 /**
  * @brief All feature functions.
  *
@@ -75,6 +90,7 @@ static FeatureFunction * const all_features[] = {
  */
 static int initialized = 0;
 
+#if MDPTETRIS_ROW_BITS == 16
 /**
  * @brief Stores for each possible row its number of transitions.
  */
@@ -84,11 +100,12 @@ static char row_transitions[NB_POSSIBLE_ROWS];
  * @brief Stores for each possible 16-bit number its number of bits 1.
  */
 static char bits_1[NB_POSSIBLE_ROWS];
+#endif
 
 /**
  * @brief The matrix of state values for feature NEXT_LOCAL_VALUE_FUNCTION.
  */
-static double *local_value_function = NULL;
+static LocalValueFunction *local_value_function = NULL;
 
 static void initialize_next_local_value_function();
 
@@ -117,7 +134,8 @@ FeatureFunction *feature_function(FeatureID feature_id) {
  * @see features_exit()
  */
 void features_initialize(const FeaturePolicy *feature_policy) {
-  uint16_t row, current_bit, previous_bit;
+#if MDPTETRIS_ROW_BITS == 16
+  BoardRow row, current_bit, previous_bit;
   int transitions, nb_bits_1, i, j;
 
   if (!initialized) {
@@ -152,6 +170,7 @@ void features_initialize(const FeaturePolicy *feature_policy) {
       /*     printf(": nb transitions: %d, nb bits 1: %d\n\n", transitions, nb_bits_1); */
     }
   }
+#endif
 
   /* if feature NEXT_LOCAL_VALUE_FUNCTION is present, we have to load the value function file */
   if (local_value_function == NULL
@@ -167,28 +186,16 @@ void features_initialize(const FeaturePolicy *feature_policy) {
  * @brief Initializes feature NEXT_LOCAL_VALUE_FUNCTION.
  *
  * This function is called if feature NEXT_LOCAL_VALUE_FUNCTION is present.
- * The value function of the 5*5 board is loaded from
- * the file \c "results_value_iteration/5_5.values".
+ * The value function of the 5*5 board is mapped from the file
+ * \c "results_value_iteration/5_5.values.map" if it exists, otherwise
+ * it is loaded from the file \c "results_value_iteration/5_5.values".
+ *
+ * @see load_local_value_function()
  */
 static void initialize_next_local_value_function() {
 
-  FILE *value_file;
-  const char *file_name = "results_value_iteration/5_5.values";
-
-  value_file = fopen(file_name, "r");
-  
-  if (value_file == NULL) {
-    DIE1("Unable to open the value file '%s'\n", file_name);
-  }
-
-  printf("Loading the value function of the 5*5 board...\n");
-
-  MALLOCN(local_value_function, double, NB_STATES);
-  fseek(value_file, sizeof(ValueIterationParameters), SEEK_SET);
-  FREAD(local_value_function, sizeof(double), NB_STATES, value_file);
-  fclose(value_file);
-
-  printf("Value function loaded\n");
+  local_value_function = load_local_value_function("results_value_iteration/5_5.values.map",
+						   "results_value_iteration/5_5.values");
 }
 
 /**
@@ -198,11 +205,157 @@ static void initialize_next_local_value_function() {
 void features_exit(void) {
 
   if (local_value_function != NULL) {
-    FREE(local_value_function);
+    free_local_value_function(local_value_function);
+    local_value_function = NULL;
   }
   initialized = 0;
 }
 
+/**
+ * @brief Returns the range of the values of a feature on a board geometry.
+ *
+ * The bounds hold for every afterstate that is not game over, with the
+ * board size and the pieces of the game: such an afterstate has no full row
+ * and its wall is not higher than the board (see game_drop_piece()).
+ * Most bounds are not reached, they are only meant to be valid.
+ *
+ * @param feature_id a feature
+ * @param game a game, to know the board size and the pieces
+ * @param min_value the lowest value of the feature
+ * @param max_value the highest value of the feature
+ * @return 1 if the bounds are known, 0 otherwise (e.g. for the features
+ * starting with NEXT, whose value depends on the previous calls)
+ */
+int feature_get_bounds(FeatureID feature_id, const Game *game, double *min_value, double *max_value) {
+  int width, height, max_piece_height, max_eroded_cells, eroded_cells, i, j, k;
+  PieceConfiguration *piece_configuration;
+  PieceOrientation *oriented_piece;
+
+  width = game->board->width;
+  height = game->board->height;
+  max_piece_height = game->board->max_piece_height;
+  *min_value = 0;
+
+  switch (feature_id) {
+
+  case CONSTANT:
+    *min_value = 1;
+    *max_value = 1;
+    break;
+
+  case LANDING_HEIGHT:
+    *max_value = game->board->extended_height;
+    break;
+
+  case ERODED_PIECE_CELLS:
+    /* the lines removed times the cells of the piece in these lines */
+    piece_configuration = game->piece_configuration;
+    max_eroded_cells = 0;
+    for (i = 0; i < piece_configuration->nb_pieces; i++) {
+      for (j = 0; j < piece_configuration->pieces[i].nb_orientations; j++) {
+	oriented_piece = &piece_configuration->pieces[i].orientations[j];
+	eroded_cells = 0;
+	for (k = 0; k < oriented_piece->height; k++) {
+	  eroded_cells += oriented_piece->nb_full_cells_on_rows[k];
+	}
+	max_eroded_cells = MAX(max_eroded_cells, oriented_piece->height * eroded_cells);
+      }
+    }
+    *max_value = max_eroded_cells;
+    break;
+
+  case ROW_TRANSITIONS:
+    /* at least 2 transitions in each row that is not full */
+    *min_value = 2 * height;
+    *max_value = (width + 1) * height;
+    break;
+
+  case COLUMN_TRANSITIONS:
+    /* at least 1 transition in each column, from the floor to the empty top */
+    *min_value = width;
+    *max_value = width * (height + 1);
+    break;
+
+  case WALL_HEIGHT:
+  case ROWS_WITH_HOLES:
+  case DISTANCE_TO_TOP:
+  case MAX_HEIGHT_DIFFERENCE:
+    *max_value = height;
+    break;
+
+  case HOLES:
+  case HOLE_DEPTHS:
+  case SURROUNDED_HOLES:
+  case OCCUPIED_CELLS:
+  case WELLS:
+    *max_value = width * height;
+    break;
+
+  case WELL_SUMS_DELLACHERIE:
+  case WELL_SUMS_FAST:
+  case WEIGHTED_CELLS:
+    *max_value = width * height * height;
+    break;
+
+  case ROWS_ELIMINATED:
+    *max_value = max_piece_height;
+    break;
+
+  case DISTANCE_TO_TOP_SQUARE:
+  case HEIGHT_SQUARE:
+    *max_value = height * height;
+    break;
+
+  case HOLE_DEPTHS_SQUARE:
+    *max_value = (double) (width * height) * (width * height);
+    break;
+
+  case DIVERSITY:
+    *max_value = 5;
+    break;
+
+  default:
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Returns an estimate of the cost of a feature function.
+ *
+ * The cost is only meant to sort the features: 0 for the features read in
+ * the last move information, 1 for the features that loop on the rows
+ * or on the columns, 2 for the features that loop on the rows and the columns.
+ *
+ * @param feature_id a feature
+ * @return the cost class of the feature
+ */
+int feature_get_cost(FeatureID feature_id) {
+
+  switch (feature_id) {
+
+  case CONSTANT:
+  case LANDING_HEIGHT:
+  case ERODED_PIECE_CELLS:
+  case WALL_HEIGHT:
+  case ROWS_ELIMINATED:
+  case DISTANCE_TO_TOP:
+  case DISTANCE_TO_TOP_SQUARE:
+  case HEIGHT_SQUARE:
+    return 0;
+
+  case WELL_SUMS_DELLACHERIE:
+  case WELL_SUMS_FAST:
+  case WELLS:
+  case NEXT_LOCAL_VALUE_FUNCTION:
+    return 2;
+
+  default:
+    return 1;
+  }
+}
+
 /**
  * @brief Feature #0: Returns always 1.
  *
@@ -261,7 +414,7 @@ double get_eroded_piece_cells(Game *game) {
  */
 double get_row_transitions(Game *game) {
   int i, wall_height, board_height, result;
-  uint16_t *board_rows;
+  BoardRow *board_rows;
   Board *board;
 
   board = game->board;
@@ -270,7 +423,7 @@ double get_row_transitions(Game *game) {
   wall_height = board->wall_height;
   result = 0;
   for (i = 0; i < wall_height; i++) {
-    result += row_transitions[board_rows[i]];
+    result += ROW_TRANSITIONS(board_rows[i]);
   }
   /* count the remaining rows */
   result += 2 * (board_height - wall_height);
@@ -292,7 +445,7 @@ double get_row_transitions(Game *game) {
  */
 double get_column_transitions(Game *game) {
   int i, wall_height, board_height, transitions;
-  uint16_t *board_rows, current_row, previous_row, xor;
+  BoardRow *board_rows, current_row, previous_row, xor;
   Board *board;
 
   board = game->board;
@@ -309,14 +462,14 @@ double get_column_transitions(Game *game) {
     xor = current_row ^ previous_row;
 
     /* count the number of 1 in the bits of xor */
-    transitions += bits_1[xor];
+    transitions += ROW_BITS_1(xor);
 
     previous_row = current_row;
   }
   /* don't forget the last row */
   current_row = board->empty_row;
   xor = current_row ^ previous_row;
-  transitions += bits_1[xor];
+  transitions += ROW_BITS_1(xor);
 
   return transitions;
 }
@@ -332,7 +485,7 @@ double get_column_transitions(Game *game) {
  */
 double get_holes(Game *game) {
   int i, holes, wall_height;
-  uint16_t *board_rows, row_holes, previous_row, current_row;
+  BoardRow *board_rows, row_holes, previous_row, current_row;
   Board *board;
 
   board = game->board;
@@ -360,7 +513,7 @@ double get_holes(Game *game) {
      * The bits 1 in row_holes indicates the holes.
      * We just count their number to know the number of holes on the current row.
      */
-    holes += bits_1[row_holes];
+    holes += ROW_BITS_1(row_holes);
 
     previous_row = current_row;
   }
@@ -439,9 +592,9 @@ double get_holes(Game *game) {
  */
 double get_well_sums_dellacherie(Game *game) {
   int i, i2, j, board_width, wall_height, result;
-  uint16_t *board_rows;
-  uint16_t well_mask;
-  uint16_t well_pattern;
+  BoardRow *board_rows;
+  BoardRow well_mask;
+  BoardRow well_pattern;
   Board *board;
 
   board = game->board;
@@ -450,8 +603,8 @@ double get_well_sums_dellacherie(Game *game) {
   wall_height = board->wall_height;
 
   result = 0;
-  well_mask = 0xE000; /* 1110000000000000 */
-  well_pattern = 0xA000; /* 1010000000000000 */
+  well_mask = brick_masks[0] | brick_masks[1] | brick_masks[2]; /* 1110000000000000 */
+  well_pattern = brick_masks[0] | brick_masks[2];                /* 1010000000000000 */
   for (j = 1; j <= board_width; j++) {
 
     /* ******************* FIX ME **********************: should be for (i = wall_height ; i >= 0; i--) { */
@@ -505,7 +658,7 @@ double get_wall_height(Game *game) {
  * @return the height of the current column
  */
 double get_next_column_height(Game *game) {
-  static int current_column = 1;
+  static __thread int current_column = 1;
   int result;
 
 /*   game_print(stdout, game); */
@@ -535,7 +688,7 @@ double get_next_column_height(Game *game) {
  * @return the difference of height between the current column and the next one
  */
 double get_next_column_height_difference(Game *game) {
-  static int current_column = 1;
+  static __thread int current_column = 1;
   int result;
   int *column_heights;
 
@@ -567,7 +720,7 @@ double get_next_column_height_difference(Game *game) {
  * of times you already called this function in the current state
  */
 double get_next_wall_height(Game *game) {
-  static int current_value = 0;
+  static __thread int current_value = 0;
   int result;
   
   /*  printf("%d %d\n",game->board->wall_height,current_value); */
@@ -593,8 +746,8 @@ double get_next_wall_height(Game *game) {
 double get_hole_depths(Game *game) {
   Board *board;
   int wall_height, result, i;
-  uint16_t *board_rows, current_row, previous_row;
-  uint16_t above_holes; /* each cell above a hole on the current row has bit 1 */
+  BoardRow *board_rows, current_row, previous_row;
+  BoardRow above_holes; /* each cell above a hole on the current row has bit 1 */
 
   board = game->board;
   wall_height = board->wall_height;
@@ -619,7 +772,7 @@ double get_hole_depths(Game *game) {
 /*     getchar(); */
 
     /* count their number (i.e. the bits 1 in above_holes) */
-    result += bits_1[above_holes];
+    result += ROW_BITS_1(above_holes);
 
     previous_row = current_row;
   }
@@ -638,7 +791,7 @@ double get_hole_depths(Game *game) {
  */
 double get_surrounded_holes(Game *game) {
   int i, holes, wall_height;
-  uint16_t *board_rows, row_holes, previous_row1, previous_row2, current_row;
+  BoardRow *board_rows, row_holes, previous_row1, previous_row2, current_row;
   Board *board;
 
   board = game->board;
@@ -667,7 +820,7 @@ double get_surrounded_holes(Game *game) {
      * The bits 1 in row_holes indicates the holes.
      * We just count their number to know the number of holes on the current row.
      */
-    holes += bits_1[row_holes];
+    holes += ROW_BITS_1(row_holes);
 
     previous_row2 = previous_row1;
     previous_row1 = current_row;
@@ -675,7 +828,7 @@ double get_surrounded_holes(Game *game) {
 
   /* consider the row -1 as full*/
   row_holes = board->full_row & ~previous_row1 & previous_row2;
-  holes += bits_1[row_holes];
+  holes += ROW_BITS_1(row_holes);
   
   /* debug */
 /*   game_print(stdout, game); */
@@ -693,7 +846,7 @@ double get_surrounded_holes(Game *game) {
 double get_rows_with_holes(Game *game) {
 
   int i, rows_with_holes, wall_height;
-  uint16_t *board_rows, row_holes, previous_row, current_row;
+  BoardRow *board_rows, row_holes, previous_row, current_row;
   Board *board;
 
   board = game->board;
@@ -747,11 +900,11 @@ double get_rows_with_holes(Game *game) {
 double get_next_local_value_function(Game *game) {
 
   /* position of the 5*5 window on the board */
-  static int local_window_x = 0;
-  static int local_window_y = 0;
+  static __thread int local_window_x = 0;
+  static __thread int local_window_y = 0;
 
-  uint16_t *board_rows;
-  uint16_t local_state_code;
+  BoardRow *board_rows;
+  uint32_t local_state_code;
   int i;
 
   /* first execution */
@@ -765,12 +918,12 @@ double get_next_local_value_function(Game *game) {
   board_rows = game->board->rows;
   for (i = local_window_y - 1; i >= local_window_y - HEIGHT; i--) {
     local_state_code = local_state_code << WIDTH;
-    local_state_code |= (board_rows[i] >> (15 - local_window_x - WIDTH)) & LAST_BITS_MASK;
+    local_state_code |= (board_rows[i] >> (MDPTETRIS_ROW_BITS - 1 - local_window_x - WIDTH)) & LAST_BITS_MASK;
 
 /*     print_row(stdout, board_rows[i]); */
 /*     printf(" with x = %d -> ", local_window_x); */
-/*     print_row(stdout, (board_rows[i] >> (15 - local_window_x - WIDTH)) & LAST_BITS_MASK); */
-/*     printf(" or %x\n", (board_rows[i] >> (15 - local_window_x - WIDTH)) & LAST_BITS_MASK); */
+/*     print_row(stdout, (board_rows[i] >> (MDPTETRIS_ROW_BITS - 1 - local_window_x - WIDTH)) & LAST_BITS_MASK); */
+/*     printf(" or %x\n", (board_rows[i] >> (MDPTETRIS_ROW_BITS - 1 - local_window_x - WIDTH)) & LAST_BITS_MASK); */
   }
   
 /*   print_board(stdout, game->board); */
@@ -789,7 +942,17 @@ double get_next_local_value_function(Game *game) {
     }
   }
 
-  return local_value_function[local_state_code];
+  /* a file with the canonical states only has one value per state and its mirror image */
+  if (local_value_function->canonical) {
+    local_state_code = get_canonical_state_rank_in_tables(local_value_function->canonical_bits,
+							  local_value_function->canonical_ranks,
+							  get_canonical_state_code(local_state_code));
+  }
+
+  if (local_value_function->values != NULL) {
+    return local_value_function->values[local_state_code];
+  }
+  return local_value_function->values_float[local_state_code];
 }
 /**
  * @brief Feature #-6 (original): Evaluates the wells and how deep they are.
@@ -836,9 +999,9 @@ double get_next_local_value_function(Game *game) {
  */
 double get_well_sums_fast(Game *game) {
   int i, j, k, board_width, wall_height, result;
-  uint16_t *board_rows;
-  uint16_t well_mask;
-  uint16_t well_pattern;
+  BoardRow *board_rows;
+  BoardRow well_mask;
+  BoardRow well_pattern;
   Board *board;
 
   board = game->board;
@@ -847,8 +1010,8 @@ double get_well_sums_fast(Game *game) {
   wall_height = board->wall_height;
 
   result = 0;
-  well_mask = 0xE000; /* 1110000000000000 */
-  well_pattern = 0xA000; /* 1010000000000000 */
+  well_mask = brick_masks[0] | brick_masks[1] | brick_masks[2]; /* 1110000000000000 */
+  well_pattern = brick_masks[0] | brick_masks[2];                /* 1010000000000000 */
   for (j = 1; j <= board_width; j++) {
 
     for (i = wall_height - 1; i >= 0; i--) {
@@ -879,7 +1042,7 @@ double get_well_sums_fast(Game *game) {
 double get_occupied_cells(Game *game) {
 
   int i, wall_height, occupied_cells;
-  uint16_t *board_rows;
+  BoardRow *board_rows;
   Board *board;
 
   board = game->board;
@@ -889,7 +1052,7 @@ double get_occupied_cells(Game *game) {
   occupied_cells = 0;
 
   for (i = 0; i < wall_height; i++) {
-    occupied_cells += bits_1[board_rows[i]] + board->width - 16;
+    occupied_cells += ROW_BITS_1(board_rows[i]) + board->width - MDPTETRIS_ROW_BITS;
   }
 
   return occupied_cells;
@@ -904,7 +1067,7 @@ double get_occupied_cells(Game *game) {
 double get_weighted_cells(Game *game) {
 
   int i, wall_height, weighted_cells;
-  uint16_t *board_rows;
+  BoardRow *board_rows;
   Board *board;
 
   board = game->board;
@@ -914,7 +1077,7 @@ double get_weighted_cells(Game *game) {
   weighted_cells = 0;
 
   for (i = 0; i < wall_height; i++) {
-    weighted_cells += (bits_1[board_rows[i]] + board->width - 16) * (i + 1);
+    weighted_cells += (ROW_BITS_1(board_rows[i]) + board->width - MDPTETRIS_ROW_BITS) * (i + 1);
   }
 
   return weighted_cells;
@@ -930,9 +1093,9 @@ double get_weighted_cells(Game *game) {
  */
 double get_wells(Game *game) {
   int i, j, board_width, wall_height, result;
-  uint16_t *board_rows;
-  uint16_t well_mask;
-  uint16_t well_pattern;
+  BoardRow *board_rows;
+  BoardRow well_mask;
+  BoardRow well_pattern;
   Board *board;
 
   board = game->board;
@@ -941,8 +1104,8 @@ double get_wells(Game *game) {
   wall_height = board->wall_height;
 
   result = 0;
-  well_mask = 0xE000; /* 1110000000000000 */
-  well_pattern = 0xA000; /* 1010000000000000 */
+  well_mask = brick_masks[0] | brick_masks[1] | brick_masks[2]; /* 1110000000000000 */
+  well_pattern = brick_masks[0] | brick_masks[2];                /* 1010000000000000 */
   for (j = 1; j <= board_width; j++) {
 
     for (i = wall_height - 1; i >= 0; i--) {
@@ -1042,7 +1205,7 @@ double get_wall_distance_to_top(Game *game) {
  * @return the height of the current column
  */
 double get_next_column_distance_to_top(Game *game) {
-  static int current_column = 1;
+  static __thread int current_column = 1;
   double result;
 
   /* game_print(stdout, game);  */
@@ -1088,7 +1251,7 @@ double get_next_column_distance_to_top(Game *game) {
  * @return the difference of height between the current column and the next one
  */
 double get_next_column_height_difference2(Game *game) {
-  static int current_column = 1;
+  static __thread int current_column = 1;
   double result;
   int *column_heights;
 
@@ -1163,7 +1326,7 @@ double get_hole_depths_square(Game *game) {
  * @return the height of the current column
  */
 double get_next_column_height2(Game *game) {
-  static int current_column = 1;
+  static __thread int current_column = 1;
   double result;
 
   /* game_print(stdout, game);  */
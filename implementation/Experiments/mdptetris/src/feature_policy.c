@@ -1,14 +1,56 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include "config.h"
 #include "feature_policy.h"
 #include "feature_functions.h"
+#include "feature_profiling.h"
 #include "game.h"
 #include "games_statistics.h"
 #include "brick_masks.h"
 #include "file_tools.h"
 #include "macros.h"
 
+/**
+ * @brief A move considered by the two-ply search.
+ */
+typedef struct LookaheadCandidate {
+  Action action;                        /**< The move. */
+  double reward;                        /**< Immediate reward of the move. */
+  double evaluation;                    /**< One-ply value: reward + evaluation of the afterstate. */
+} LookaheadCandidate;
+
+/**
+ * @brief Maximum number of features of a policy evaluated lazily.
+ */
+#define LAZY_EVALUATION_MAX_FEATURES 64
+
+/**
+ * @brief Margin kept when a move is discarded, for the rounding errors
+ * (the features are not summed in the same order).
+ */
+#define LAZY_EVALUATION_MARGIN(evaluation) (1e-9 * (1 + fabs(evaluation)))
+
+/**
+ * @brief The order and the bounds of the features to evaluate a move lazily.
+ */
+typedef struct LazyEvaluation {
+  int nb_features;                                      /**< Number of features of the policy. */
+  int order[LAZY_EVALUATION_MAX_FEATURES];              /**< Indexes of the features, the cheapest ones first. */
+  double remaining[LAZY_EVALUATION_MAX_FEATURES + 1];   /**< Highest possible rating of the features
+							 * order[i], order[i + 1]... */
+} LazyEvaluation;
+
+/*
+ * Private functions.
+ */
+static void features_get_best_action_lookahead(Game *game, const FeaturePolicy *feature_policy, Action *best_action);
+static double features_evaluate_next_pieces(Game *game, const FeaturePolicy *feature_policy,
+					     const LazyEvaluation *lazy_evaluation);
+static int lazy_evaluation_init(LazyEvaluation *lazy_evaluation, const Game *game, const FeaturePolicy *feature_policy);
+static double evaluate_features_lazy(Game *game, const FeaturePolicy *feature_policy,
+				     const LazyEvaluation *lazy_evaluation, double reward, double best_evaluation);
 
 
 /**
@@ -47,13 +89,13 @@ double evaluate_features(Game *game, const FeaturePolicy *feature_policy) {
   }
   else {               /* general case: evaluate with the features */
     if (feature_policy->update_column_heights_needed) {
-      board_update_column_heights(game->board);
+      FEATURES_UPDATE_COLUMN_HEIGHTS(game->board);
     }
     nb_features = feature_policy->nb_features;
     rating = 0;
     for (i = 0; i < nb_features; i++) {
       feature = &feature_policy->features[i];
-      rating += feature->get_feature_rating(game) * feature->weight;
+      rating += FEATURE_RATING(feature, game) * feature->weight;
     }
   }
   return rating;
@@ -76,14 +118,14 @@ double *get_feature_values(Game *game, const FeaturePolicy *feature_policy) {
   MALLOCN(feature_values, double, feature_policy->nb_features);
   
   if (feature_policy->update_column_heights_needed) {
-    board_update_column_heights(game->board);
+    FEATURES_UPDATE_COLUMN_HEIGHTS(game->board);
   }
 
 /*   printf("\n---------\n"); */
 /*   print_board(stdout, game->board); */
 
   for (i = 0; i < feature_policy->nb_features; i++) {
-    feature_values[i] = feature_policy->features[i].get_feature_rating(game);
+    feature_values[i] = FEATURE_RATING(&feature_policy->features[i], game);
 /*     printf("feature %d (id = %d): %f\n", i, feature_policy->features[i].feature_id, feature_values[i]); */
   }
 /*   getchar(); */
@@ -99,14 +141,30 @@ double *get_feature_values(Game *game, const FeaturePolicy *feature_policy) {
  * This evaluation is added to the reward obtained. The action that
  * maximiz this value is selected.
  *
+ * If \c feature_policy->lookahead_candidates is not zero, the best moves
+ * are searched with one more piece, see features_get_best_action_lookahead().
+ *
+ * If \c feature_policy->lazy_evaluation is set, the cheapest features are
+ * computed first and a move is discarded as soon as the other features cannot
+ * make it better than the best move so far, see evaluate_features_lazy().
+ * The move chosen is the same.
+ *
  * @param game the current game state
  * @param feature_policy the feature based policy
  * @param best_action pointer to store the best action found
  */
 void features_get_best_action(Game *game, const FeaturePolicy *feature_policy, Action *best_action) {
-  int nb_possible_orientations, nb_possible_columns, i, j;
+  int nb_possible_orientations, nb_possible_columns, i, j, lazy;
   double evaluation, best_evaluation;
   Action action;
+  LazyEvaluation lazy_evaluation;
+
+  if (feature_policy->lookahead_candidates > 0) {
+    features_get_best_action_lookahead(game, feature_policy, best_action);
+    return;
+  }
+
+  lazy = feature_policy->lazy_evaluation && lazy_evaluation_init(&lazy_evaluation, game, feature_policy);
 
   best_evaluation = -TETRIS_INFINITE;
   best_action->orientation = 0;
@@ -131,7 +189,13 @@ void features_get_best_action(Game *game, const FeaturePolicy *feature_policy, A
       }
       */
 
-      evaluation = feature_policy->reward_description.reward_function(game) + evaluate_features(game, feature_policy);
+      if (lazy) {
+	evaluation = evaluate_features_lazy(game, feature_policy, &lazy_evaluation,
+					    feature_policy->reward_description.reward_function(game), best_evaluation);
+      }
+      else {
+	evaluation = feature_policy->reward_description.reward_function(game) + evaluate_features(game, feature_policy);
+      }
       
       /*board_print(stdout, game->board);*/
       /*game_print_features(game, feature_policy);*/
@@ -149,6 +213,285 @@ void features_get_best_action(Game *game, const FeaturePolicy *feature_policy, A
   }
 }
 
+/**
+ * @brief Chooses the best action in a state with a two-ply search.
+ *
+ * The value of a move is its one-ply value plus the mean, over the next pieces,
+ * of the best one-ply value with this piece. The one-ply value of the move is
+ * kept because some features rate the move rather than the board (e.g. the
+ * landing height): without it, the search plays worse than the one-ply search.
+ *
+ * Searching all the moves this way is too costly, so every move is first rated
+ * with the one-ply value, and only the \c feature_policy->lookahead_candidates
+ * best ones are searched. Moves leading to the same board share the value of
+ * the next pieces, which is computed once.
+ *
+ * The afterstates of the second ply are evaluated one at a time, in place:
+ * each move is dropped, rated and cancelled with the undo log of the board.
+ * They are not gathered in a batch, because the features read the board of
+ * the game, so a batch would copy every afterstate board, and the lazy
+ * evaluation (see evaluate_features_lazy()) needs the best value found so far.
+ *
+ * @param game the current game state
+ * @param feature_policy the feature based policy
+ * @param best_action pointer to store the best action found
+ */
+static void features_get_best_action_lookahead(Game *game, const FeaturePolicy *feature_policy, Action *best_action) {
+  int nb_possible_orientations, nb_possible_columns, nb_candidates, nb_searched, nb_boards;
+  int i, j, best, board_size, wall_height;
+  double evaluation, best_evaluation, *board_values;
+  int *board_wall_heights;
+  BoardRow *boards;
+  LookaheadCandidate *candidates, tmp_candidate;
+  Action action;
+  LazyEvaluation lazy_evaluation;
+
+  /* rate every move with the one-ply value */
+  nb_candidates = 0;
+  nb_possible_orientations = game_get_nb_possible_orientations(game);
+  for (i = 0; i < nb_possible_orientations; i++) {
+    nb_candidates += game_get_nb_possible_columns(game, i);
+  }
+  MALLOCN(candidates, LookaheadCandidate, nb_candidates);
+
+  nb_candidates = 0;
+  for (i = 0; i < nb_possible_orientations; i++) {
+    action.orientation = i;
+    nb_possible_columns = game_get_nb_possible_columns(game, i);
+    for (j = 1; j <= nb_possible_columns; j++) {
+      action.column = j;
+      game_drop_piece(game, &action, 1);
+      candidates[nb_candidates].action = action;
+      candidates[nb_candidates].reward = feature_policy->reward_description.reward_function(game);
+      candidates[nb_candidates].evaluation = candidates[nb_candidates].reward + evaluate_features(game, feature_policy);
+      nb_candidates++;
+      game_cancel_last_move(game);
+    }
+  }
+
+  /* move the best candidates to the beginning, in the order of the one-ply search */
+  nb_searched = MIN(feature_policy->lookahead_candidates, nb_candidates);
+  for (i = 0; i < nb_searched; i++) {
+    best = i;
+    for (j = i + 1; j < nb_candidates; j++) {
+      if (DOUBLE_GREATER_THAN(candidates[j].evaluation, candidates[best].evaluation)) {
+	best = j;
+      }
+    }
+    tmp_candidate = candidates[best];
+    for (j = best; j > i; j--) {
+      candidates[j] = candidates[j - 1];
+    }
+    candidates[i] = tmp_candidate;
+  }
+
+  /* search the best candidates with the next pieces, where only the best move of each piece counts */
+  if (!feature_policy->lazy_evaluation || !lazy_evaluation_init(&lazy_evaluation, game, feature_policy)) {
+    lazy_evaluation.nb_features = -1;
+  }
+
+  board_size = game->board->extended_height;
+  MALLOCN(boards, BoardRow, nb_searched * board_size);
+  MALLOCN(board_wall_heights, int, nb_searched);
+  MALLOCN(board_values, double, nb_searched);
+  nb_boards = 0;
+
+  best_evaluation = -TETRIS_INFINITE;
+  *best_action = candidates[0].action;
+  for (i = 0; i < nb_searched; i++) {
+    game_drop_piece(game, &candidates[i].action, 1);
+
+    if (game->game_over) {
+      /* no next piece: the move keeps its one-ply value, which already rates the gameover state */
+      evaluation = candidates[i].evaluation;
+    }
+    else {
+      /* the same board may have been searched already */
+      wall_height = game->board->wall_height;
+      for (j = 0; j < nb_boards; j++) {
+	if (board_wall_heights[j] == wall_height
+	    && !memcmp(&boards[j * board_size], game->board->rows, wall_height * sizeof(BoardRow))) {
+	  break;
+	}
+      }
+      if (j == nb_boards) {
+	MEMCPY(&boards[j * board_size], game->board->rows, BoardRow, wall_height);
+	board_wall_heights[j] = wall_height;
+	board_values[j] = features_evaluate_next_pieces(game, feature_policy,
+							(lazy_evaluation.nb_features >= 0) ? &lazy_evaluation : NULL);
+	nb_boards++;
+      }
+      evaluation = candidates[i].evaluation + board_values[j];
+    }
+
+    if (DOUBLE_GREATER_THAN(evaluation, best_evaluation)) {
+      best_evaluation = evaluation;
+      *best_action = candidates[i].action;
+    }
+    game_cancel_last_move(game);
+  }
+
+  FREE(board_values);
+  FREE(board_wall_heights);
+  FREE(boards);
+  FREE(candidates);
+}
+
+/**
+ * @brief Returns the mean over the pieces of the best one-ply value with this piece.
+ *
+ * All the moves of all the pieces are tried on the current board,
+ * which is the afterstate of a move of features_get_best_action_lookahead().
+ *
+ * @param game the current game state, not over
+ * @param feature_policy the feature based policy
+ * @param lazy_evaluation the order and bounds of the features to evaluate the moves lazily,
+ * or \c NULL to evaluate them completely
+ * @return the value of the board before the next piece is known
+ */
+static double features_evaluate_next_pieces(Game *game, const FeaturePolicy *feature_policy,
+					     const LazyEvaluation *lazy_evaluation) {
+  int nb_pieces, piece_index, nb_possible_orientations, nb_possible_columns, i, j;
+  double evaluation, best_evaluation, sum;
+  Action action;
+
+  nb_pieces = game->piece_configuration->nb_pieces;
+  sum = 0;
+  for (piece_index = 0; piece_index < nb_pieces; piece_index++) {
+    game_set_current_piece_index(game, piece_index);
+
+    best_evaluation = -TETRIS_INFINITE;
+    nb_possible_orientations = game_get_nb_possible_orientations(game);
+    for (i = 0; i < nb_possible_orientations; i++) {
+      action.orientation = i;
+      nb_possible_columns = game_get_nb_possible_columns(game, i);
+      for (j = 1; j <= nb_possible_columns; j++) {
+	action.column = j;
+	game_drop_piece(game, &action, 1);
+	if (lazy_evaluation != NULL) {
+	  evaluation = evaluate_features_lazy(game, feature_policy, lazy_evaluation,
+					      feature_policy->reward_description.reward_function(game), best_evaluation);
+	}
+	else {
+	  evaluation = feature_policy->reward_description.reward_function(game) + evaluate_features(game, feature_policy);
+	}
+	if (evaluation > best_evaluation) {
+	  best_evaluation = evaluation;
+	}
+	game_cancel_last_move(game);
+      }
+    }
+    sum += best_evaluation;
+  }
+
+  return sum / nb_pieces;
+}
+
+/**
+ * @brief Prepares the lazy evaluation of the moves.
+ *
+ * The features are sorted by cost (see feature_get_cost()) and the highest
+ * possible rating of each one is computed from its bounds on the board
+ * geometry (see feature_get_bounds()).
+ * The lazy evaluation is not possible if a feature has no bounds (e.g. the
+ * features starting with NEXT, that must be called in order), or if the
+ * gameover states are evaluated with the features (the bounds hold only for
+ * the other states).
+ *
+ * @param lazy_evaluation the structure to fill
+ * @param game the current game state
+ * @param feature_policy the feature based policy
+ * @return 1 if the moves can be evaluated lazily, 0 otherwise
+ */
+static int lazy_evaluation_init(LazyEvaluation *lazy_evaluation, const Game *game, const FeaturePolicy *feature_policy) {
+  int nb_features, i, j, index;
+  double weight, min_value, max_value;
+  Feature *feature;
+
+  nb_features = feature_policy->nb_features;
+  if (nb_features > LAZY_EVALUATION_MAX_FEATURES || feature_policy->gameover_evaluation == 1) {
+    return 0;
+  }
+
+  /* insertion sort of the features by cost, keeping the order of the policy for the same cost */
+  for (i = 0; i < nb_features; i++) {
+    index = i;
+    for (j = i; j > 0 && feature_get_cost(feature_policy->features[lazy_evaluation->order[j - 1]].feature_id)
+	   > feature_get_cost(feature_policy->features[index].feature_id); j--) {
+      lazy_evaluation->order[j] = lazy_evaluation->order[j - 1];
+    }
+    lazy_evaluation->order[j] = index;
+  }
+
+  /* highest possible rating of the remaining features */
+  lazy_evaluation->remaining[nb_features] = 0;
+  for (i = nb_features - 1; i >= 0; i--) {
+    feature = &feature_policy->features[lazy_evaluation->order[i]];
+    if (!feature_get_bounds(feature->feature_id, game, &min_value, &max_value)) {
+      return 0;
+    }
+    weight = feature->weight;
+    lazy_evaluation->remaining[i] = lazy_evaluation->remaining[i + 1] + MAX(weight * min_value, weight * max_value);
+  }
+  lazy_evaluation->nb_features = nb_features;
+
+  return 1;
+}
+
+/**
+ * @brief Evaluates a move, unless it cannot be better than the best move so far.
+ *
+ * The features are computed in the order given by lazy_evaluation_init().
+ * If the features computed and the highest possible rating of the others
+ * cannot beat \c best_evaluation, the other features are not computed.
+ * Otherwise, the value returned is exactly the one of features_get_best_action()
+ * without lazy evaluation.
+ *
+ * @param game the game state after the move
+ * @param feature_policy the feature based policy
+ * @param lazy_evaluation the order and bounds of the features
+ * @param reward the immediate reward of the move
+ * @param best_evaluation the value of the best move so far
+ * @return the value of the move, or a value lower than \c best_evaluation
+ * if the move cannot be better
+ */
+static double evaluate_features_lazy(Game *game, const FeaturePolicy *feature_policy,
+				     const LazyEvaluation *lazy_evaluation, double reward, double best_evaluation) {
+  double ratings[LAZY_EVALUATION_MAX_FEATURES];
+  double rating, bound;
+  int nb_features, i, index;
+  Feature *feature;
+
+  if (game->game_over) {
+    return reward + evaluate_features(game, feature_policy);
+  }
+
+  if (feature_policy->update_column_heights_needed) {
+    FEATURES_UPDATE_COLUMN_HEIGHTS(game->board);
+  }
+
+  nb_features = lazy_evaluation->nb_features;
+  bound = reward;
+  for (i = 0; i < nb_features; i++) {
+    index = lazy_evaluation->order[i];
+    feature = &feature_policy->features[index];
+    ratings[index] = FEATURE_RATING(feature, game) * feature->weight;
+    bound += ratings[index];
+
+    if (bound + lazy_evaluation->remaining[i + 1] < best_evaluation - LAZY_EVALUATION_MARGIN(best_evaluation)) {
+      return bound + lazy_evaluation->remaining[i + 1];
+    }
+  }
+
+  /* same sum as evaluate_features() */
+  rating = 0;
+  for (i = 0; i < nb_features; i++) {
+    rating += ratings[i];
+  }
+
+  return reward + rating;
+}
+
 /**
  * @brief Plays a game with a feature policy.
  * @param feature_policy the feature policy
@@ -281,6 +624,8 @@ void load_feature_policy(const char *feature_file_name, FeaturePolicy *feature_p
   feature_policy->features = features;
   feature_policy->nb_features = nb_features;
   feature_policy->update_column_heights_needed = update_column_heights_needed;
+  feature_policy->lookahead_candidates = 0;
+  feature_policy->lazy_evaluation = 0;
 
   /* initialize the features system for these feature functions */
   features_initialize(feature_policy);
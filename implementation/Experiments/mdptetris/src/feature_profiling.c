@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "config.h"
+#include "feature_profiling.h"
+#include "board.h"
+
+#ifdef FEATURE_PROFILING
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/**
+ * Number of slots in the counters: one per feature ID, from -NB_ORIGINAL_FEATURES
+ * to VARIATION_HOLES, and a last one for the update of the column heights.
+ */
+#define NB_PROFILED_FEATURES (NB_ORIGINAL_FEATURES + VARIATION_HOLES + 1)
+#define COLUMN_HEIGHTS_SLOT NB_PROFILED_FEATURES
+
+static uint64_t nb_calls[NB_PROFILED_FEATURES + 1];
+static uint64_t nb_cycles[NB_PROFILED_FEATURES + 1];
+static int report_registered = 0;
+
+/*
+ * Private functions.
+ */
+static uint64_t read_cycle_counter(void);
+static void add_call(int slot, uint64_t cycles);
+static void print_at_exit(void);
+
+/**
+ * @brief Returns the current value of the cycle counter
+ * (nanoseconds on the architectures without one).
+ */
+static uint64_t read_cycle_counter(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Counts a call that took some cycles.
+ *
+ * The counters are updated atomically so that games can be played in several threads.
+ */
+static void add_call(int slot, uint64_t cycles) {
+
+  if (!__atomic_load_n(&report_registered, __ATOMIC_RELAXED)
+      && !__atomic_exchange_n(&report_registered, 1, __ATOMIC_RELAXED)) {
+    atexit(print_at_exit);
+  }
+
+  __atomic_fetch_add(&nb_calls[slot], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&nb_cycles[slot], cycles, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Computes the value of a feature and counts its cost.
+ * @param feature the feature
+ * @param game the game state
+ * @return the value of the feature
+ */
+double feature_profiling_get_rating(const Feature *feature, Game *game) {
+  uint64_t start;
+  double rating;
+
+  start = read_cycle_counter();
+  rating = feature->get_feature_rating(game);
+  add_call(feature->feature_id + NB_ORIGINAL_FEATURES, read_cycle_counter() - start);
+
+  return rating;
+}
+
+/**
+ * @brief Updates the column heights and counts the cost.
+ * @param board the board
+ */
+void feature_profiling_update_column_heights(Board *board) {
+  uint64_t start;
+
+  start = read_cycle_counter();
+  board_update_column_heights(board);
+  add_call(COLUMN_HEIGHTS_SLOT, read_cycle_counter() - start);
+}
+
+/**
+ * @brief Prints the calls and cycles counted for each feature.
+ *
+ * This function is called automatically when the program exits.
+ *
+ * @param out the file to write
+ */
+void feature_profiling_print(FILE *out) {
+  int i;
+  uint64_t total_cycles;
+
+  total_cycles = 0;
+  for (i = 0; i <= NB_PROFILED_FEATURES; i++) {
+    total_cycles += nb_cycles[i];
+  }
+
+  fprintf(out, "# Feature profiling (cycles spent in evaluate_features and get_feature_values)\n");
+  fprintf(out, "# feature\t      calls\t         cycles\tcycles/call\t share\n");
+  for (i = 0; i <= NB_PROFILED_FEATURES; i++) {
+    if (nb_calls[i] != 0) {
+      if (i == COLUMN_HEIGHTS_SLOT) {
+	fprintf(out, "  heights");
+      }
+      else {
+	fprintf(out, "  %7d", i - NB_ORIGINAL_FEATURES);
+      }
+      fprintf(out, "\t%11llu\t%15llu\t%11.1f\t%5.1f%%\n",
+	      (unsigned long long) nb_calls[i], (unsigned long long) nb_cycles[i],
+	      (double) nb_cycles[i] / nb_calls[i], 100.0 * nb_cycles[i] / total_cycles);
+    }
+  }
+}
+
+/**
+ * @brief Prints the profiling report on the standard error.
+ */
+static void print_at_exit(void) {
+  feature_profiling_print(stderr);
+}
+
+#endif
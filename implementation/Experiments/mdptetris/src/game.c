@@ -12,11 +12,12 @@
  * Private functions.
  */
 static void restore_previous_piece(Game *game);
+static Board *get_game_board_block(Game *game);
 
 /**
  * @brief Creates a new tetris game.
  *
- * @param width board width (10 in standard Tetris; must be lower than or equal to 14)
+ * @param width board width (10 in standard Tetris; must be lower than or equal to BOARD_MAX_WIDTH)
  * @param height board height (20 in standard Tetris)
  * @param allow_lines_after_overflow 1 to enable the lines completion when the piece overflows
  * @param pieces_file_name a file describing the pieces (pieces4.dat for standard Tetris)
@@ -27,16 +28,23 @@ static void restore_previous_piece(Game *game);
  */
 Game *new_game(int tetris_implementation, int width, int height, int allow_lines_after_overflow, const char *pieces_file_name, int *piece_sequence) {
   Game *game;
+  PieceConfiguration *piece_configuration;
 
+  MALLOC(piece_configuration, PieceConfiguration);
+  load_pieces(pieces_file_name, &piece_configuration->nb_pieces, &piece_configuration->pieces);
 
-  MALLOC(game, Game);
-  MALLOC(game->piece_configuration, PieceConfiguration);
-  load_pieces(pieces_file_name, &game->piece_configuration->nb_pieces, &game->piece_configuration->pieces);
+  /* the game and its board are stored in one block */
+  MALLOC_ALIGNED(game, Game, CACHE_LINE_ROUND(sizeof(Game))
+		 + board_get_block_size(width, height, piece_configuration->nb_pieces, piece_configuration->pieces));
+  game->piece_configuration = piece_configuration;
   game->tetris_implementation = tetris_implementation;
-  game->board = new_board(width, height, allow_lines_after_overflow,
-			  game->piece_configuration->nb_pieces, game->piece_configuration->pieces);
+  game->board = get_game_board_block(game);
+  board_init(game->board, width, height, allow_lines_after_overflow,
+	     piece_configuration->nb_pieces, piece_configuration->pieces);
   game->piece_configuration->piece_sequence = piece_sequence;
   game->piece_configuration->nb_games = 1;
+  game->random_generator = NULL;
+  game_reset_counters(game);
   game_reset(game);
 
   return game;
@@ -87,13 +95,20 @@ Game *new_game_from_parameters(CommonParameters *parameters) {
 Game *new_game_copy(const Game *other) {
   
   Game *game;
-  MALLOC(game, Game);
+  MALLOC_ALIGNED(game, Game, CACHE_LINE_ROUND(sizeof(Game)) + other->board->block_size);
   *game = *other;
 
-  /* deep copy of the board */
-  game->tetris_implementation=other->tetris_implementation;
-  game->board = new_board_copy(other->board);
-  game->piece_configuration->nb_games++;
+  /* deep copy of the board, in the block of the game */
+  game->board = get_game_board_block(game);
+  board_copy(game->board, other->board);
+
+  /* the threads of a search copy and free games of the same configuration */
+  __atomic_add_fetch(&game->piece_configuration->nb_games, 1, __ATOMIC_RELAXED);
+
+  /* the copy continues the random stream on its own */
+  if (other->random_generator != NULL) {
+    game->random_generator = new_random_generator_copy(other->random_generator);
+  }
 
   return game;
 }
@@ -106,8 +121,7 @@ Game *new_game_copy(const Game *other) {
 void free_game(Game *game) {
   int i;
 
-  game->piece_configuration->nb_games--;
-  if (game->piece_configuration->nb_games == 0) {
+  if (__atomic_sub_fetch(&game->piece_configuration->nb_games, 1, __ATOMIC_ACQ_REL) == 0) {
     /* free the piece configuration if it is not used anymore */
     for (i = 0; i < game->piece_configuration->nb_pieces; i++) {
       free_piece(&game->piece_configuration->pieces[i]);
@@ -116,10 +130,95 @@ void free_game(Game *game) {
     FREE(game->piece_configuration);
   }
 
-  free_board(game->board);
+  if (game->random_generator != NULL) {
+    free_random_generator(game->random_generator);
+  }
+
+  /* the board is in the block of the game */
   FREE(game);
 }
 
+/**
+ * @brief Returns the place of the board in the block of a game,
+ * right after the game structure.
+ */
+static Board *get_game_board_block(Game *game) {
+  return (Board*) ((char*) game + CACHE_LINE_ROUND(sizeof(Game)));
+}
+
+/**
+ * @brief Creates a snapshot of a game state.
+ * @param game the game to save
+ * @return the snapshot created
+ * @see game_save_snapshot(), game_restore_snapshot(), free_game_snapshot()
+ */
+GameSnapshot *new_game_snapshot(const Game *game) {
+  GameSnapshot *snapshot;
+
+  MALLOC(snapshot, GameSnapshot);
+  snapshot->game = *game;
+  snapshot->board = new_board_copy(game->board);
+
+  return snapshot;
+}
+
+/**
+ * @brief Saves a game state into an existing snapshot.
+ *
+ * The game must have the same board size as the game of the snapshot.
+ *
+ * @param snapshot the snapshot to overwrite
+ * @param game the game to save
+ * @see new_game_snapshot(), game_restore_snapshot()
+ */
+void game_save_snapshot(GameSnapshot *snapshot, const Game *game) {
+  snapshot->game = *game;
+  board_copy(snapshot->board, game->board);
+}
+
+/**
+ * @brief Restores a game state saved in a snapshot.
+ *
+ * The game keeps its own board, random stream and counters, and the pieces
+ * of its piece configuration, which must be the same as the pieces of the saved game
+ * (e.g. the game is a copy of the saved game made with new_game_copy()).
+ * Nothing is allocated: the fields are copied in place.
+ *
+ * @param game the game to change
+ * @param snapshot the saved state
+ * @see new_game_snapshot(), game_save_snapshot()
+ */
+void game_restore_snapshot(Game *game, const GameSnapshot *snapshot) {
+  PieceConfiguration *piece_configuration;
+  Board *board;
+  RandomGenerator *random_generator;
+  GameCounters counters;
+
+  piece_configuration = game->piece_configuration;
+  board = game->board;
+  random_generator = game->random_generator;
+  counters = game->counters;
+
+  *game = snapshot->game;
+
+  game->piece_configuration = piece_configuration;
+  game->board = board;
+  game->random_generator = random_generator;
+  game->counters = counters;
+  game->current_piece = &piece_configuration->pieces[game->current_piece_index];
+  board_copy(board, snapshot->board);
+}
+
+/**
+ * @brief Destroys a snapshot.
+ * @param snapshot the snapshot to destroy
+ * @see new_game_snapshot()
+ */
+void free_game_snapshot(GameSnapshot *snapshot) {
+  free_board(snapshot->board);
+  FREE(snapshot);
+}
+
 /**
  * @brief Returns the number of possible orientations for the current piece.
  *
@@ -184,7 +283,12 @@ void generate_next_piece(Game *game) {
 
   if (piece_configuration->piece_sequence == NULL) {
     /* the pieces are generated randomly */
-    piece_index = random_uniform(0, piece_configuration->nb_pieces);
+    if (game->random_generator != NULL) {
+      piece_index = random_generator_uniform(game->random_generator, 0, piece_configuration->nb_pieces);
+    }
+    else {
+      piece_index = random_uniform(0, piece_configuration->nb_pieces);
+    }
   }
   else {
     /* the pieces are generated from a sequence */
@@ -277,6 +381,7 @@ int game_drop_piece(Game *game, const Action *action, int cancellable) {
 /*   Piece *piece; */
 /*   PieceOrientation *oriented_piece; */
   int removed_lines;
+  GameUndo *undo;
 
   /* ensure the game is not over */
   if (game->game_over) {
@@ -301,11 +406,27 @@ int game_drop_piece(Game *game, const Action *action, int cancellable) {
     break;
   }
 
+  /* save the game state if necessary (the board has checked the depth of the undo log) */
+  if (cancellable) {
+    undo = &game->undo_log[game->undo_depth++];
+    undo->score = game->score;
+    undo->previous_piece_index = game->previous_piece_index;
+  }
+
   game->previous_piece_index = game->current_piece_index;
 
   /* update the score*/
   game->score += removed_lines;
 
+  /* update the counters */
+  if (cancellable) {
+    game->counters.nb_afterstates++;
+  }
+  else {
+    game->counters.nb_pieces++;
+    game->counters.nb_lines += removed_lines;
+  }
+
   switch(game->tetris_implementation) {
   
   case 0: /* SIMPLIFIED */
@@ -391,20 +512,28 @@ int game_drop_piece(Game *game, const Action *action, int cancellable) {
  *
  * The last dropped piece is removed and the previous game state is restored.
  * This is possible only if \c cancellable was set to \c 1 when you called
- * game_drop_piece().
+ * game_drop_piece(). Nested moves are cancelled in the reverse order,
+ * see board_cancel_last_move().
+ * The information about the last move (\c last_move_info) is not restored.
  *
  * @param game the game
  * @see game_drop_piece()
  */
 void game_cancel_last_move(Game *game) {
-  game->score -= game->last_move_info.removed_lines;
+  GameUndo *undo;
+
+  board_cancel_last_move(game->board);
+
   if (game->game_over) {
     game->game_over = 0;
   }
   else {
     restore_previous_piece(game);
   }
-  board_cancel_last_move(game->board);
+
+  undo = &game->undo_log[--game->undo_depth];
+  game->score = undo->score;
+  game->previous_piece_index = undo->previous_piece_index;
 }
 
 /**
@@ -419,6 +548,7 @@ void game_reset(Game *game) {
   board_reset(game->board);
   game->game_over = 0;
   game->score = 0;
+  game->undo_depth = 0;
   game->current_piece_sequence_index = -1;
   game->last_move_info.removed_lines = 0;
   game->last_move_info.landing_height_bottom = 0;
@@ -427,6 +557,39 @@ void game_reset(Game *game) {
   generate_next_piece(game);
 }
 
+/**
+ * @brief Resets the counters of the work done in the game.
+ *
+ * @param game the game
+ * @see GameCounters
+ */
+void game_reset_counters(Game *game) {
+  game->counters.nb_pieces = 0;
+  game->counters.nb_afterstates = 0;
+  game->counters.nb_lines = 0;
+}
+
+/**
+ * @brief Gives the game its own random stream and resets the game.
+ *
+ * Once a game has a seed, its pieces no longer depend on the global
+ * random generator, so a game played with a given seed always receives the
+ * same pieces, whatever the other games played meanwhile (e.g. in other threads).
+ * Use random_derive_seed() to obtain a different seed for each game.
+ *
+ * @param game the game
+ * @param seed seed of the stream of pieces
+ */
+void game_set_seed(Game *game, unsigned long seed) {
+  if (game->random_generator == NULL) {
+    game->random_generator = new_random_generator(seed);
+  }
+  else {
+    random_generator_set_seed(game->random_generator, seed);
+  }
+  game_reset(game);
+}
+
 /**
  * @brief Prints a human-readable view of the current state in a file.
  *
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "local_value_function.h"
+#include "simple_tetris.h"
+#include "macros.h"
+
+/*
+ * Private functions.
+ */
+static LocalValueFunction *map_local_value_function(const char *mapped_file_name);
+static LocalValueFunction *read_local_value_function(const char *values_file_name);
+
+/**
+ * @brief Loads a local value function.
+ *
+ * The mapped values file is used if it exists, otherwise the values are read
+ * from the file saved by the value iteration program.
+ * The program stops with an error message if no file can be used.
+ *
+ * @param mapped_file_name name of the mapped values file (can be NULL)
+ * @param values_file_name name of the values file of the value iteration program
+ * @return the local value function
+ * @see free_local_value_function()
+ */
+LocalValueFunction *load_local_value_function(const char *mapped_file_name, const char *values_file_name) {
+  LocalValueFunction *local_value_function = NULL;
+
+  if (mapped_file_name != NULL) {
+    local_value_function = map_local_value_function(mapped_file_name);
+  }
+
+  if (local_value_function == NULL) {
+    local_value_function = read_local_value_function(values_file_name);
+  }
+
+  return local_value_function;
+}
+
+/**
+ * @brief Maps a mapped values file in memory.
+ *
+ * The header is checked against the size of the small board of this build
+ * before anything else is read in the file.
+ *
+ * @param mapped_file_name name of the file
+ * @return the local value function, or NULL if the file does not exist
+ */
+static LocalValueFunction *map_local_value_function(const char *mapped_file_name) {
+  LocalValueFunction *local_value_function;
+  const LocalValueFunctionHeader *header;
+  struct stat file_stat;
+  uint64_t values_end, expected_size;
+  const uint64_t *canonical_bits;
+  const uint32_t *canonical_ranks;
+  void *mapping;
+  int fd;
+
+  fd = open(mapped_file_name, O_RDONLY);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t) sizeof(LocalValueFunctionHeader)) {
+    DIE1("Invalid mapped values file '%s'", mapped_file_name);
+  }
+
+  mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    DIE1("Unable to map the values file '%s'", mapped_file_name);
+  }
+
+  header = (const LocalValueFunctionHeader*) mapping;
+  if (memcmp(header->magic, LOCAL_VALUE_FUNCTION_MAGIC, sizeof(header->magic)) != 0
+      || header->version < 1 || header->version > LOCAL_VALUE_FUNCTION_VERSION
+      || header->byte_order != 0x01020304
+      || (header->value_size != sizeof(double) && header->value_size != sizeof(float))
+      || header->width != WIDTH
+      || header->height != HEIGHT
+      || (header->canonical && header->version < 3)
+      || header->nb_states > NB_STATES
+      || (!header->canonical && header->nb_states != NB_STATES)) {
+    DIE1("The mapped values file '%s' does not match this board size or format", mapped_file_name);
+  }
+
+  values_end = sizeof(LocalValueFunctionHeader) + header->nb_states * header->value_size;
+  expected_size = values_end;
+  if (header->canonical) {
+    expected_size = header->tables_offset + NB_CANONICAL_TABLE_WORDS * (sizeof(uint64_t) + sizeof(uint32_t));
+  }
+  if ((header->canonical && (header->tables_offset < values_end || header->tables_offset % 64 != 0))
+      || (uint64_t) file_stat.st_size != expected_size) {
+    DIE1("The mapped values file '%s' is truncated or corrupted", mapped_file_name);
+  }
+
+  canonical_bits = NULL;
+  canonical_ranks = NULL;
+  if (header->canonical) {
+    canonical_bits = (const uint64_t*) ((const char*) mapping + header->tables_offset);
+    canonical_ranks = (const uint32_t*) (canonical_bits + NB_CANONICAL_TABLE_WORDS);
+    if (canonical_ranks[NB_CANONICAL_TABLE_WORDS - 1]
+	+ __builtin_popcountll(canonical_bits[NB_CANONICAL_TABLE_WORDS - 1]) != header->nb_states) {
+      DIE1("The mapped values file '%s' is truncated or corrupted", mapped_file_name);
+    }
+  }
+
+  /* the states are visited in no particular order */
+  madvise(mapping, file_stat.st_size, MADV_RANDOM);
+
+  MALLOC(local_value_function, LocalValueFunction);
+  local_value_function->mapping = mapping;
+  local_value_function->mapped_size = file_stat.st_size;
+  local_value_function->canonical = header->canonical;
+  local_value_function->canonical_bits = canonical_bits;
+  local_value_function->canonical_ranks = canonical_ranks;
+  local_value_function->values = NULL;
+  local_value_function->values_float = NULL;
+  if (header->value_size == sizeof(double)) {
+    local_value_function->values = (const double*) (header + 1);
+  }
+  else {
+    local_value_function->values_float = (const float*) (header + 1);
+  }
+
+  return local_value_function;
+}
+
+/**
+ * @brief Reads the values saved by the value iteration program.
+ * @param values_file_name name of the file
+ * @return the local value function
+ */
+static LocalValueFunction *read_local_value_function(const char *values_file_name) {
+  LocalValueFunction *local_value_function;
+  double *values;
+  FILE *value_file;
+
+  value_file = fopen(values_file_name, "r");
+  if (value_file == NULL) {
+    DIE1("Unable to open the value file '%s'\n", values_file_name);
+  }
+
+  printf("Loading the value function of the 5*5 board...\n");
+
+  MALLOCN(values, double, NB_STATES);
+  fseek(value_file, sizeof(ValueIterationParameters), SEEK_SET);
+  FREAD(values, sizeof(double), NB_STATES, value_file);
+  fclose(value_file);
+
+  printf("Value function loaded\n");
+
+  MALLOC(local_value_function, LocalValueFunction);
+  local_value_function->values = values;
+  local_value_function->values_float = NULL;
+  local_value_function->mapping = NULL;
+  local_value_function->mapped_size = 0;
+  local_value_function->canonical = 0;
+  local_value_function->canonical_bits = NULL;
+  local_value_function->canonical_ranks = NULL;
+
+  return local_value_function;
+}
+
+/**
+ * @brief Frees a local value function.
+ * @param local_value_function the local value function
+ * @see load_local_value_function()
+ */
+void free_local_value_function(LocalValueFunction *local_value_function) {
+
+  if (local_value_function->mapping != NULL) {
+    munmap(local_value_function->mapping, local_value_function->mapped_size);
+  }
+  else {
+    free((double*) local_value_function->values);
+  }
+  FREE(local_value_function);
+}
+
+/**
+ * @brief Saves some state values in a mapped values file.
+ * @param mapped_file_name name of the file to write
+ * @param values the NB_STATES values
+ * @param use_float 1 to store the values as floats (half the size), 0 to store them as doubles
+ * @param canonical 1 to store the values of the canonical states only (half the size),
+ * which requires that each state has the same value as its mirror image
+ */
+void save_mapped_local_value_function(const char *mapped_file_name, const double *values, int use_float, int canonical) {
+  LocalValueFunctionHeader header;
+  FILE *mapped_file;
+  float value_float;
+  uint64_t *canonical_bits = NULL;
+  uint32_t *canonical_ranks = NULL;
+  uint64_t values_end = 0;
+  uint32_t s;
+  char zero = 0;
+
+  mapped_file = fopen(mapped_file_name, "w");
+  if (mapped_file == NULL) {
+    DIE1("Unable to write the mapped values file '%s'", mapped_file_name);
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LOCAL_VALUE_FUNCTION_MAGIC, sizeof(LOCAL_VALUE_FUNCTION_MAGIC));
+  header.version = LOCAL_VALUE_FUNCTION_VERSION;
+  header.byte_order = 0x01020304;
+  header.value_size = use_float ? sizeof(float) : sizeof(double);
+  header.width = WIDTH;
+  header.height = HEIGHT;
+  header.canonical = canonical;
+  header.nb_states = NB_STATES;
+  if (canonical) {
+    MALLOCN(canonical_bits, uint64_t, NB_CANONICAL_TABLE_WORDS);
+    MALLOCN(canonical_ranks, uint32_t, NB_CANONICAL_TABLE_WORDS);
+    header.nb_states = compute_canonical_states(canonical_bits, canonical_ranks);
+    values_end = sizeof(header) + header.nb_states * header.value_size;
+    header.tables_offset = (values_end + 63) / 64 * 64;
+  }
+  FWRITE(&header, sizeof(header), 1, mapped_file);
+
+  /* the canonical states are numbered in the order of their codes */
+  for (s = 0; s < NB_STATES; s++) {
+    if (canonical && !(canonical_bits[s / 64] & ((uint64_t) 1 << (s % 64)))) {
+      continue;
+    }
+    if (use_float) {
+      value_float = values[s];
+      FWRITE(&value_float, sizeof(float), 1, mapped_file);
+    }
+    else {
+      FWRITE(&values[s], sizeof(double), 1, mapped_file);
+    }
+  }
+
+  if (canonical) {
+    for (; values_end < header.tables_offset; values_end++) {
+      FWRITE(&zero, 1, 1, mapped_file);
+    }
+    FWRITE(canonical_bits, sizeof(uint64_t), NB_CANONICAL_TABLE_WORDS, mapped_file);
+    FWRITE(canonical_ranks, sizeof(uint32_t), NB_CANONICAL_TABLE_WORDS, mapped_file);
+    FREE(canonical_bits);
+    FREE(canonical_ranks);
+  }
+
+  fclose(mapped_file);
+}
@@ -10,6 +10,7 @@
  * Private function.
  */
 static void piece_orientation_init(PieceOrientation *orientation, int width, int height);
+static void piece_orientation_place(PieceOrientation *orientation);
 
 /**
  * @brief Creates a set of pieces as described in a given file.
@@ -108,6 +109,11 @@ void load_pieces(const char *file_name, int *nb_pieces, Piece **pieces) {
       }
     } /* for each orientation*/
 
+    /* precompute the shape of each orientation on each column */
+    for (o = 0; o < current_piece->nb_orientations; o++) {
+      piece_orientation_place(&current_piece->orientations[o]);
+    }
+
   } /* for each piece */
   
   FREE(line);
@@ -129,10 +135,36 @@ static void piece_orientation_init(PieceOrientation *orientation, int width, int
   orientation->height = height;
 
   /* allocate the memory for the bricks */
-  CALLOC(orientation->bricks, uint16_t, height);
+  CALLOC(orientation->bricks, BoardRow, height);
   CALLOC(orientation->nb_full_cells_on_rows, int, height);
 }
 
+/**
+ * @brief Computes the shape of a piece orientation placed on each column.
+ *
+ * The drop functions read these rows instead of shifting the piece
+ * for every collision test.
+ *
+ * @param orientation the piece orientation, with its bricks already set
+ */
+static void piece_orientation_place(PieceOrientation *orientation) {
+  int column, i;
+  BoardRow *placed_bricks;
+
+  orientation->nb_columns = BOARD_MAX_WIDTH - orientation->width + 1;
+  if (orientation->nb_columns < 1) {
+    DIE1("A piece is wider than the widest board (%d columns)\n", BOARD_MAX_WIDTH);
+  }
+
+  MALLOCN(orientation->placed_bricks, BoardRow, orientation->nb_columns * orientation->height);
+  for (column = 1; column <= orientation->nb_columns; column++) {
+    placed_bricks = PIECE_PLACED_BRICKS(orientation, column);
+    for (i = 0; i < orientation->height; i++) {
+      placed_bricks[i] = orientation->bricks[i] >> column;
+    }
+  }
+}
+
 /**
  * @brief Destroys a piece.
  * @param piece the piece to destroy
@@ -142,6 +174,7 @@ void free_piece(Piece *piece) {
   for (i = 0; i < piece->nb_orientations; i++) {
     free(piece->orientations[i].bricks);
     free(piece->orientations[i].nb_full_cells_on_rows);
+    free(piece->orientations[i].placed_bricks);
   }
   free(piece->orientations);
 }
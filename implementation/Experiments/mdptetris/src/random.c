@@ -1,8 +1,10 @@
 #include <time.h>
+#include <stdint.h>
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_sort_double.h>
 #include "config.h"
 #include "random.h"
+#include "macros.h"
 
 static gsl_rng *gsl_random_generator = NULL;
 
@@ -39,3 +41,76 @@ int random_uniform(int a, int b) {
 double random_gaussian(double mu, double sigma) {
   return gsl_ran_gaussian(gsl_random_generator, sigma) + mu;
 }
+
+/**
+ * A random number generator with its own stream.
+ */
+struct RandomGenerator {
+  gsl_rng *gsl_generator;
+};
+
+/**
+ * Derives the seed of a child stream from the seed of its parent.
+ *
+ * The seed is obtained by hashing the parent seed with the child index
+ * (splitmix64 finalizer), so that a whole hierarchy of streams
+ * (run, generation, candidate, game) can be rebuilt from the run seed only,
+ * whatever the order in which the children are evaluated.
+ */
+unsigned long random_derive_seed(unsigned long parent_seed, unsigned long child_index) {
+  uint64_t z;
+
+  z = (uint64_t) parent_seed + 0x9E3779B97F4A7C15ULL * ((uint64_t) child_index + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+
+  return (unsigned long) z;
+}
+
+/**
+ * Creates a random number generator with its own stream.
+ */
+RandomGenerator *new_random_generator(unsigned long seed) {
+  RandomGenerator *generator;
+
+  MALLOC(generator, RandomGenerator);
+  generator->gsl_generator = gsl_rng_alloc(gsl_rng_taus);
+  gsl_rng_set(generator->gsl_generator, seed);
+
+  return generator;
+}
+
+/**
+ * Creates a copy of a random number generator, at the same position in the stream.
+ */
+RandomGenerator *new_random_generator_copy(const RandomGenerator *other) {
+  RandomGenerator *generator;
+
+  MALLOC(generator, RandomGenerator);
+  generator->gsl_generator = gsl_rng_clone(other->gsl_generator);
+
+  return generator;
+}
+
+/**
+ * Frees a random number generator.
+ */
+void free_random_generator(RandomGenerator *generator) {
+  gsl_rng_free(generator->gsl_generator);
+  FREE(generator);
+}
+
+/**
+ * Restarts the stream of a random number generator with a new seed.
+ */
+void random_generator_set_seed(RandomGenerator *generator, unsigned long seed) {
+  gsl_rng_set(generator->gsl_generator, seed);
+}
+
+/**
+ * Returns an integer number in [a,b[ from the stream of a random number generator.
+ */
+int random_generator_uniform(RandomGenerator *generator, int a, int b) {
+  return gsl_ran_flat(generator->gsl_generator, a, b);
+}
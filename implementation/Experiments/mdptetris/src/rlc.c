@@ -255,6 +255,8 @@ static void generate_feature_sample(const RLCParameters *parameters, FeaturePoli
     feature_policy->update_column_heights_needed = parameters->feature_policy.update_column_heights_needed;
     feature_policy->reward_description = parameters->common_parameters.reward_description;
     feature_policy->gameover_evaluation = 1;
+    feature_policy->lookahead_candidates = parameters->feature_policy.lookahead_candidates;
+    feature_policy->lazy_evaluation = parameters->feature_policy.lazy_evaluation;
 
     for (i = 0; i < nb_features; i++) {
       features[i] = parameters->feature_policy.features[i];
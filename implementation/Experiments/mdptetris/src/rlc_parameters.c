@@ -451,6 +451,8 @@ void rlc_load_feature_policy(RLCParameters *parameters) {
   parameters->feature_policy.features = features;
   parameters->feature_policy.nb_features = nb_features;
   parameters->feature_policy.update_column_heights_needed = update_column_heights_needed;
+  parameters->feature_policy.lookahead_candidates = 0;
+  parameters->feature_policy.lazy_evaluation = 0;
 }
 
 /**
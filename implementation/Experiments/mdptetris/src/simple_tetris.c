@@ -1,3 +1,4 @@
+#include <string.h>
 #include "config.h"
 #include "simple_tetris.h"
 #include "brick_masks.h"
@@ -8,7 +9,7 @@
  */
 uint32_t get_game_code(Game *game) {
   uint32_t state_code;
-  uint16_t *board_rows;
+  BoardRow *board_rows;
   int i;
 
   state_code = 0;
@@ -27,8 +28,8 @@ uint32_t get_game_code(Game *game) {
  * corresponding to a integer code.
  */
 void set_game_state(Game *game, uint32_t state_code) {
-  uint16_t *board_rows;
-  uint16_t row, empty_row;
+  BoardRow *board_rows;
+  BoardRow row, empty_row;
   int i;
   int wall_height;
 
@@ -37,7 +38,7 @@ void set_game_state(Game *game, uint32_t state_code) {
   empty_row = game->board->empty_row;
   for (i = 0; i < HEIGHT; i++) {
     wall_height = i;
-    row = (uint16_t) (state_code & LAST_BITS_MASK);
+    row = (BoardRow) (state_code & LAST_BITS_MASK);
     if (!row) { /* the row is empty */
       board_rows[i] = empty_row;
     }
@@ -48,3 +49,172 @@ void set_game_state(Game *game, uint32_t state_code) {
   }
   game->board->wall_height = i;
 }
+
+/**
+ * Canonical states: bit s of canonical_bits is set if state s is canonical,
+ * and canonical_ranks[i] is the number of canonical states before the
+ * 64 states of canonical_bits[i].
+ */
+static uint64_t *canonical_bits = NULL;
+static uint32_t *canonical_ranks = NULL;
+static uint32_t nb_canonical_states = 0;
+
+/**
+ * Returns the code of the state mirrored left-right.
+ */
+uint32_t get_mirror_state_code(uint32_t state_code) {
+  uint32_t mirror_code;
+  uint32_t column_bits; /* the bits of the first column in every row */
+  int i;
+
+  column_bits = 0;
+  for (i = 0; i < HEIGHT; i++) {
+    column_bits = (column_bits << WIDTH) | 1;
+  }
+
+  /* move each column at once, for all rows */
+  mirror_code = 0;
+  for (i = 0; i < WIDTH; i++) {
+    mirror_code |= ((state_code >> i) & column_bits) << (WIDTH - 1 - i);
+  }
+
+  return mirror_code;
+}
+
+/**
+ * Returns the canonical state of a state and its mirror image,
+ * that is, the one with the smallest code.
+ */
+uint32_t get_canonical_state_code(uint32_t state_code) {
+  uint32_t mirror_code;
+
+  mirror_code = get_mirror_state_code(state_code);
+  return MIN(state_code, mirror_code);
+}
+
+/**
+ * Returns 1 if the set of pieces is closed under left-right mirroring:
+ * each piece mirrored is a piece of the set, in any of its orientations
+ * (the pieces are compared by their shape only). Returns 0 otherwise.
+ */
+int pieces_are_symmetric(PieceConfiguration *piece_configuration) {
+  PieceOrientation *orientation, *other;
+  BoardRow mirror_bricks[16];
+  int i, j, k, o, row;
+  int found;
+
+  for (i = 0; i < piece_configuration->nb_pieces; i++) {
+
+    /* mirror the first orientation of piece i */
+    orientation = &piece_configuration->pieces[i].orientations[0];
+    for (row = 0; row < orientation->height; row++) {
+      mirror_bricks[row] = 0;
+      for (k = 0; k < orientation->width; k++) {
+	if (orientation->bricks[row] & brick_masks[k]) {
+	  mirror_bricks[row] |= brick_masks[orientation->width - 1 - k];
+	}
+      }
+    }
+
+    /* look for a piece with this shape */
+    found = 0;
+    for (j = 0; j < piece_configuration->nb_pieces && !found; j++) {
+      for (o = 0; o < piece_configuration->pieces[j].nb_orientations && !found; o++) {
+	other = &piece_configuration->pieces[j].orientations[o];
+	if (other->width == orientation->width && other->height == orientation->height) {
+	  found = 1;
+	  for (row = 0; row < other->height; row++) {
+	    if (other->bricks[row] != mirror_bricks[row]) {
+	      found = 0;
+	    }
+	  }
+	}
+      }
+    }
+
+    if (!found) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * Numbers the canonical states.
+ * This function must be called before get_nb_canonical_states()
+ * and get_canonical_state_rank().
+ */
+void initialize_canonical_states() {
+
+  if (canonical_bits != NULL) {
+    return;
+  }
+
+  MALLOCN(canonical_bits, uint64_t, NB_CANONICAL_TABLE_WORDS);
+  MALLOCN(canonical_ranks, uint32_t, NB_CANONICAL_TABLE_WORDS);
+  nb_canonical_states = compute_canonical_states(canonical_bits, canonical_ranks);
+}
+
+/**
+ * Fills the numbering tables of the canonical states (NB_CANONICAL_TABLE_WORDS
+ * words each), see canonical_bits and canonical_ranks.
+ * Returns the number of canonical states.
+ */
+uint32_t compute_canonical_states(uint64_t *bits, uint32_t *ranks) {
+  uint32_t s, nb_states;
+
+  memset(bits, 0, NB_CANONICAL_TABLE_WORDS * sizeof(uint64_t));
+  nb_states = 0;
+  for (s = 0; s < NB_STATES; s++) {
+    if (s % 64 == 0) {
+      ranks[s / 64] = nb_states;
+    }
+    if (get_canonical_state_code(s) == s) {
+      bits[s / 64] |= (uint64_t) 1 << (s % 64);
+      nb_states++;
+    }
+  }
+
+  return nb_states;
+}
+
+/**
+ * Frees the numbering of the canonical states.
+ */
+void exit_canonical_states() {
+
+  if (canonical_bits != NULL) {
+    FREE(canonical_bits);
+    FREE(canonical_ranks);
+  }
+}
+
+/**
+ * Returns the number of canonical states (about half of NB_STATES).
+ */
+uint32_t get_nb_canonical_states() {
+  return nb_canonical_states;
+}
+
+/**
+ * Returns the number of a canonical state, between 0 and get_nb_canonical_states()-1.
+ * The canonical states are numbered in the order of their codes.
+ */
+uint32_t get_canonical_state_rank(uint32_t canonical_state_code) {
+  return get_canonical_state_rank_in_tables(canonical_bits, canonical_ranks, canonical_state_code);
+}
+
+/**
+ * Same as get_canonical_state_rank(), with numbering tables filled by
+ * compute_canonical_states() (e.g. the ones of a mapped values file).
+ */
+uint32_t get_canonical_state_rank_in_tables(const uint64_t *bits, const uint32_t *ranks,
+					    uint32_t canonical_state_code) {
+  uint64_t previous_bits;
+
+  previous_bits = bits[canonical_state_code / 64]
+    & (((uint64_t) 1 << (canonical_state_code % 64)) - 1);
+
+  return ranks[canonical_state_code / 64] + __builtin_popcountll(previous_bits);
+}
@@ -12,17 +12,21 @@ RESTE A FAIRE:
 
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <gsl/gsl_sort_double.h>
 #include "config.h"
 #include "uct.h"
 #include "game.h"
-#include "hashtable.h"
+#include "board.h"
 #include "feature_policy.h"
 #include "random.h"
 #include "macros.h"
 
 #define NB_SIMU_BEFORE_CREATION 1
-#define HASHTABLE_SIZE 512
+#define UCT_MAX_NODES 65536 /* capacity of the node pool */
 #define DEPTH_MAX 100
 
 #define MAX_ACTIONS 34 /* depends on the board width and the shape of the pieces */
@@ -44,17 +48,91 @@ struct UctNode
   
   /* sons */
   UctNodeStats sons_stats[MAX_ACTIONS][NB_ALEA];
+
+  /* game state of the node, to check the hashtable matches */
+  uint64_t hash;
+  int piece_index;
+  int wall_height;
+  BoardRow *rows;  /* the wall_height lowest rows of the board (stored in the table) */
 };
 
-/* FIXME: pas en variable globale */
-static Hashtable *hashtable;
+/**
+ * A slot of the open addressing table.
+ */
+typedef struct UctTableSlot
+{
+  uint64_t hash;  /* Zobrist hash of the node */
+  int node;       /* index of the node in the pool plus one, 0 if the slot is free */
+} UctTableSlot;
+
+/**
+ * The nodes of the tree, indexed by a Zobrist hash of the board and the current piece.
+ * The nodes come from a pool allocated once: a lookup or an insertion never allocates memory.
+ */
+struct UctTable
+{
+  int max_nodes;          /* capacity of the pool */
+  int nb_nodes;           /* number of nodes used in the pool */
+  UctNode *nodes;         /* the pool */
+  BoardRow *rows;         /* the board rows of each node (nb_rows per node) */
+  int nb_rows;            /* number of rows of the board, including the hidden rows */
+
+  UctTableSlot *slots;    /* open addressing table, with twice as many slots as nodes */
+  uint64_t mask;          /* number of slots - 1 */
+
+  uint64_t *zobrist_rows;   /* random key of each byte value of each row (nb_rows * sizeof(BoardRow) * 256) */
+  uint64_t *zobrist_pieces; /* random key of each current piece */
+};
 
-static const char* compute_key(Game *game);
+/**
+ * What a thread needs to develop its own tree.
+ * The threads do not share anything during a move (root parallelization):
+ * their trees are merged at the root when the time is over.
+ */
+typedef struct UctContext
+{
+  pthread_t thread;
+  UctTable *table;                    /* the tree of this thread */
+  UctNode *root;                      /* root of the tree for the current move */
+  GameSnapshot *snapshot;             /* the current game state */
+  Game *game;                         /* scratch game of the simulations, restored from the snapshot
+				       * (with the random stream of this thread for the next pieces) */
+  int nb_simulations;                 /* number of simulations of the current move */
+
+  /* parameters of the current move */
+  struct timespec end_time;
+  double (*value_estimator)(Game *game);
+  double (*heuristic)(Game *game);
+
+  /* stacks for updating the stats at the end of the current simulation */
+  UctNode *node_stack[DEPTH_MAX];
+  int action_stack[DEPTH_MAX];
+  int score_stack[DEPTH_MAX];
+  int alea_stack[DEPTH_MAX];
+} UctContext;
+
+/**
+ * A parallel UCT search: one tree per thread.
+ */
+struct UctSearch
+{
+  int nb_threads;
+  int max_nodes;          /* capacity of the table of each thread */
+  UctContext *contexts;
+};
+
+static FeaturePolicy *heuristic_feature_policy;
+
+static uint64_t zobrist_random(uint64_t *state);
+static uint64_t get_game_hash(const UctTable *table, const Game *game);
+static int uct_node_matches(const UctNode *node, const Game *game);
+static void uct_node_init(UctNode *node, Game *game, double (*heuristic)(Game *game));
 static double bandit(int nb_trials, int total_trials, double sum_rewards);
-static double simu_and_update(UctNode *root, Game *game,
+static void *uct_worker(void *arg);
+static double simu_and_update(UctContext *context, UctNode *root, Game *game,
 			      double (*valueEstimator)(Game *game), double (*heuristic)(Game *game));
-static int get_ucb_action(UctNode *father, Game *game);
-static void cumulate_ucb_stats(UctNode *father, Game *son, int num_action,
+static int get_ucb_action(UctTable *table, UctNode *father, Game *game);
+static void cumulate_ucb_stats(UctTable *table, UctNode *father, Game *son, int num_action,
 			       int num_random, UctNodeStats *uct_node_stats);
 
 static double heuristic(Game *game);
@@ -64,31 +142,183 @@ static double heuristic(Game *game);
 
 
 /**
- * @brief Computes a string key representing a game state.
- *
- * You never have to free the string returned.
- *
+ * @brief Creates the table of the nodes.
+ * @param game a game with the board size and the pieces of the games to store
+ * @param max_nodes capacity of the table
+ */
+UctTable *uct_table_new(const Game *game, int max_nodes)
+{
+  UctTable *table;
+  uint64_t nb_slots, random_state;
+  int i;
+
+  MALLOC(table, UctTable);
+  table->max_nodes = max_nodes;
+  table->nb_nodes = 0;
+  table->nb_rows = game->board->extended_height;
+
+  /* the pages of the pool are only used when the nodes are created */
+  CALLOC(table->nodes, UctNode, max_nodes);
+  CALLOC(table->rows, BoardRow, (size_t) max_nodes * table->nb_rows);
+
+  nb_slots = 1;
+  while (nb_slots < 2 * (uint64_t) max_nodes) {
+    nb_slots <<= 1;
+  }
+  CALLOC(table->slots, UctTableSlot, nb_slots);
+  table->mask = nb_slots - 1;
+
+  /* the keys are the same in each run */
+  random_state = 0;
+  MALLOCN(table->zobrist_rows, uint64_t, table->nb_rows * sizeof(BoardRow) * 256);
+  for (i = 0; i < table->nb_rows * (int) sizeof(BoardRow) * 256; i++) {
+    table->zobrist_rows[i] = zobrist_random(&random_state);
+  }
+  MALLOCN(table->zobrist_pieces, uint64_t, game->piece_configuration->nb_pieces);
+  for (i = 0; i < game->piece_configuration->nb_pieces; i++) {
+    table->zobrist_pieces[i] = zobrist_random(&random_state);
+  }
+
+  return table;
+}
+
+/**
+ * @brief Destroys the table and all its nodes.
+ */
+void uct_table_free(UctTable *table)
+{
+  FREE(table->nodes);
+  FREE(table->rows);
+  FREE(table->slots);
+  FREE(table->zobrist_rows);
+  FREE(table->zobrist_pieces);
+  FREE(table);
+}
+
+/**
+ * @brief Removes all nodes of the table.
+ */
+void uct_table_clear(UctTable *table)
+{
+  table->nb_nodes = 0;
+  memset(table->slots, 0, (table->mask + 1) * sizeof(UctTableSlot));
+}
+
+/**
+ * @brief Returns the number of nodes in the table.
+ */
+int uct_table_get_nb_nodes(const UctTable *table)
+{
+  return table->nb_nodes;
+}
+
+/**
+ * @brief Returns the node of a game state (board and current piece), or NULL if there is none.
+ */
+UctNode *uct_table_get(UctTable *table, const Game *game)
+{
+  uint64_t hash, i;
+  UctTableSlot *slot;
+  UctNode *node;
+
+  hash = get_game_hash(table, game);
+
+  for (i = hash & table->mask; table->slots[i].node != 0; i = (i + 1) & table->mask) {
+    slot = &table->slots[i];
+    node = &table->nodes[slot->node - 1];
+
+    /* two states can have the same hash: check the board */
+    if (slot->hash == hash && uct_node_matches(node, game)) {
+      return node;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Creates the node of a game state, which must not be in the table yet.
+ * @param table the table
  * @param game the game state
+ * @param heuristic a function indicating the quality of a state, used to sort the actions
+ * @return the node created, or NULL if the table is full
  */
-static const char* compute_key(Game *game)
+UctNode *uct_table_add(UctTable *table, Game *game, double (*heuristic)(Game *game))
 {
-  static char key[256];
+  uint64_t hash, i;
+  UctNode *node;
   Board *board;
-  size_t size;
+
+  if (table->nb_nodes == table->max_nodes) {
+    return NULL;
+  }
+
+  hash = get_game_hash(table, game);
+  for (i = hash & table->mask; table->slots[i].node != 0; i = (i + 1) & table->mask);
+
+  node = &table->nodes[table->nb_nodes];
+  uct_node_init(node, game, heuristic);
 
   board = game->board;
-  size = board->height * 2;
+  node->hash = hash;
+  node->piece_index = game->current_piece_index;
+  node->wall_height = board->wall_height;
+  node->rows = &table->rows[(size_t) table->nb_nodes * table->nb_rows];
+  MEMCPY(node->rows, board->rows, BoardRow, board->wall_height);
 
-  MEMCPY(key, board->rows, char, size);
-  key[size] = game->current_piece_index + 1;
-  key[size + 1] = '\0';
+  table->nb_nodes++;
+  table->slots[i].hash = hash;
+  table->slots[i].node = table->nb_nodes;
 
-  /* debug
-  if (strlen(key) != size + 1) {
-    DIE2("Computed a bad key: %s (length = %d)\n", key, strlen(key));
-  }*/
+  return node;
+}
+
+/**
+ * @brief Generates the random keys of the table (splitmix64).
+ * @param state state of the generator
+ */
+static uint64_t zobrist_random(uint64_t *state)
+{
+  uint64_t z;
+
+  z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Computes the Zobrist hash of a game state (board and current piece).
+ *
+ * The rows above the wall are empty and do not change the hash.
+ */
+static uint64_t get_game_hash(const UctTable *table, const Game *game)
+{
+  const BoardRow *rows;
+  const uint64_t *row_keys;
+  uint64_t hash;
+  int i, b;
+
+  rows = game->board->rows;
+  hash = table->zobrist_pieces[game->current_piece_index];
+  for (i = 0; i < game->board->wall_height; i++) {
+    row_keys = &table->zobrist_rows[i * sizeof(BoardRow) * 256];
+    for (b = 0; b < (int) sizeof(BoardRow); b++) {
+      hash ^= row_keys[b * 256 + ((rows[i] >> (8 * b)) & 0xFF)];
+    }
+  }
 
-  return key;
+  return hash;
+}
+
+/**
+ * @brief Returns whether a node corresponds to a game state.
+ */
+static int uct_node_matches(const UctNode *node, const Game *game)
+{
+  return node->piece_index == game->current_piece_index
+    && node->wall_height == game->board->wall_height
+    && memcmp(node->rows, game->board->rows, node->wall_height * sizeof(BoardRow)) == 0;
 }
 
 /**
@@ -109,59 +339,172 @@ static double bandit(int nb_trials, int total_trials, double sum_rewards)
 
 
 /**
- * @brief Develops the tree from the game configuration and returns the most simulated action.
- * @param root root node of the tree
+ * @brief Creates a parallel UCT search.
+ * @param game a game with the board size and the pieces of the games to play
+ * @param nb_threads number of threads developing a tree
+ * @param max_nodes capacity of the tree of each thread
+ * @param seed seed of the random streams of the threads
+ * @see think()
+ */
+UctSearch *uct_search_new(const Game *game, int nb_threads, int max_nodes, unsigned long seed)
+{
+  UctSearch *search;
+  UctContext *context;
+  int t;
+
+  MALLOC(search, UctSearch);
+  search->nb_threads = nb_threads;
+  search->max_nodes = max_nodes;
+  CALLOC(search->contexts, UctContext, nb_threads);
+
+  for (t = 0; t < nb_threads; t++) {
+    context = &search->contexts[t];
+    context->table = uct_table_new(game, max_nodes);
+    context->snapshot = new_game_snapshot(game);
+    context->game = new_game_copy(game);
+    game_set_seed(context->game, random_derive_seed(seed, t));
+    context->root = NULL;
+  }
+
+  return search;
+}
+
+/**
+ * @brief Destroys a parallel UCT search and its trees.
+ */
+void uct_search_free(UctSearch *search)
+{
+  UctContext *context;
+  int t;
+
+  for (t = 0; t < search->nb_threads; t++) {
+    context = &search->contexts[t];
+    uct_table_free(context->table);
+    free_game_snapshot(context->snapshot);
+    free_game(context->game);
+  }
+  FREE(search->contexts);
+  FREE(search);
+}
+
+/**
+ * @brief Develops the trees from the game configuration and returns the most simulated action.
+ *
+ * Each thread develops its own tree until the time is over (root parallelization).
+ * The statistics of the actions at the root are then summed over the trees.
+ * The trees are kept from one move to the next one.
+ *
+ * @param search the search
  * @param game game configuration (wall+piece) from which to develop the tree
  * @param time time in miliseconds to think
  * @param value_estimator a function estimating the expected reward of a state
  * @param heuristic a function indicating the quality of a state, used to sort the actions
  * @return the most simulated action
  */
-Action think(UctNode *root, const Game *game, double time,
+Action think(UctSearch *search, const Game *game, double time,
 	     double (*value_estimator)(Game *game), double (*heuristic)(Game *game))
 {
   int nb_simu_max = 0;
-  int i, j;
+  int i, j, k, t;
   int best_action = -1;
-  clock_t end_time = clock() + time * CLOCKS_PER_SEC / 1000;
+  int nb_simulations;
+  struct timespec end_time;
   Action action;
-  UctNodeStats stats;
+  UctNodeStats stats[MAX_ACTIONS];
+  UctNodeStats action_stats;
+  UctContext *context;
+  UctNode *root, *thread_root;
+
+  /* wall clock time: clock() would count the time of all threads */
+  clock_gettime(CLOCK_MONOTONIC, &end_time);
+  end_time.tv_sec += (long) (time / 1000);
+  end_time.tv_nsec += (long) (fmod(time, 1000) * 1000000);
+  if (end_time.tv_nsec >= 1000000000) {
+    end_time.tv_sec++;
+    end_time.tv_nsec -= 1000000000;
+  }
+
+  /* prepare the trees */
+  for (t = 0; t < search->nb_threads; t++) {
+    context = &search->contexts[t];
+    game_save_snapshot(context->snapshot, game);
+    game_restore_snapshot(context->game, context->snapshot);
 
-  Game *gamecopy;
+    /* start again from an empty tree when the pool is half full */
+    if (uct_table_get_nb_nodes(context->table) > search->max_nodes / 2) {
+      uct_table_clear(context->table);
+    }
+
+    /* the new game state may not be in the tree: this happens if the
+       random simulations never picked the right "next piece" */
+    context->root = uct_table_get(context->table, context->game);
+    if (context->root == NULL) {
+      context->root = uct_table_add(context->table, context->game, heuristic);
+    }
 
+    context->end_time = end_time;
+    context->value_estimator = value_estimator;
+    context->heuristic = heuristic;
+  }
 
-  /* develops the tree */
-  i=0;
-  while (clock() < end_time)    {
-      gamecopy=new_game_copy(game);
-      simu_and_update(root, gamecopy, value_estimator, heuristic);
-      i++;
-      free_game(gamecopy);
+  /* develops the trees, this thread develops the first one */
+  for (t = 1; t < search->nb_threads; t++) {
+    if (pthread_create(&search->contexts[t].thread, NULL, uct_worker, &search->contexts[t]) != 0) {
+      DIE("Cannot create a thread");
+    }
   }
-  printf("Launched %d simulations\n",i);
+  uct_worker(&search->contexts[0]);
 
-  gamecopy=new_game_copy(game);
+  nb_simulations = search->contexts[0].nb_simulations;
+  for (t = 1; t < search->nb_threads; t++) {
+    pthread_join(search->contexts[t].thread, NULL);
+    nb_simulations += search->contexts[t].nb_simulations;
+  }
+  printf("Launched %d simulations on %d thread(s)\n", nb_simulations, search->nb_threads);
 
-  /* find the most simulated action */
+  /* sum the stats of each action over the trees,
+     in the order of the actions of the first tree */
+  root = search->contexts[0].root;
   for (i = 0; i < root->nb_possible_actions; i++) {
-    stats.nb_simu = 0; 
-    stats.sum_rewards = 0; 
-    game_drop_piece(gamecopy,&(root->possible_actions[i]),1);
-    
-    for (j = 0; j < NB_ALEA; j++) {      
-      game_set_current_piece_index(gamecopy,j);     
-      
-      cumulate_ucb_stats(root, gamecopy, i, j, &stats);
-    }   
+    stats[i].nb_simu = 0;
+    stats[i].sum_rewards = 0;
+  }
 
-    game_cancel_last_move(gamecopy);
- 
-    if (stats.nb_simu > nb_simu_max) {
+  for (t = 0; t < search->nb_threads; t++) {
+    context = &search->contexts[t];
+    thread_root = context->root;
+    game_restore_snapshot(context->game, context->snapshot);
+
+    for (k = 0; k < thread_root->nb_possible_actions; k++) {
+      action_stats.nb_simu = 0;
+      action_stats.sum_rewards = 0;
+      game_drop_piece(context->game, &(thread_root->possible_actions[k]), 1);
+
+      for (j = 0; j < NB_ALEA; j++) {
+	game_set_current_piece_index(context->game, j);
+
+	cumulate_ucb_stats(context->table, thread_root, context->game, k, j, &action_stats);
+      }
+
+      game_cancel_last_move(context->game);
+
+      for (i = 0; i < root->nb_possible_actions; i++) {
+	if (root->possible_actions[i].column == thread_root->possible_actions[k].column
+	    && root->possible_actions[i].orientation == thread_root->possible_actions[k].orientation) {
+	  stats[i].nb_simu += action_stats.nb_simu;
+	  stats[i].sum_rewards += action_stats.sum_rewards;
+	}
+      }
+    }
+  }
+
+  /* find the most simulated action */
+  for (i = 0; i < root->nb_possible_actions; i++) {
+    if (stats[i].nb_simu > nb_simu_max) {
       best_action = i;
-      nb_simu_max = stats.nb_simu;
+      nb_simu_max = stats[i].nb_simu;
     }
   }
-  free_game(gamecopy);
 
   printf("Best action: action=%d (nbsimu=%d)\n", best_action, nb_simu_max);
   
@@ -176,15 +519,41 @@ Action think(UctNode *root, const Game *game, double time,
   return action;
 }
 
+/**
+ * @brief Main function of a thread: runs simulations in its tree until the end of the move.
+ * @param arg the UctContext of the thread
+ */
+static void *uct_worker(void *arg)
+{
+  UctContext *context = (UctContext*) arg;
+  struct timespec now;
+
+  context->nb_simulations = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  while (now.tv_sec < context->end_time.tv_sec
+	 || (now.tv_sec == context->end_time.tv_sec && now.tv_nsec < context->end_time.tv_nsec)) {
+
+    game_restore_snapshot(context->game, context->snapshot);
+    simu_and_update(context, context->root, context->game, context->value_estimator, context->heuristic);
+    context->nb_simulations++;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  }
+
+  return NULL;
+}
+
 /**
  * @brief Simulates and provides an estimated average reward.
+ * @param context the thread running the simulation
  * @param root the root node
  * @param game the game
  * @param value_estimator a function estimating the expected reward of a state
  * @param heuristic a function indicating the quality of a state, used to sort the actions
  * @return a prediction of the future score from root/game
  */
-static double simu_and_update(UctNode *root, Game *game,
+static double simu_and_update(UctContext *context, UctNode *root, Game *game,
 			      double (*value_estimator)(Game *game), double(*heuristic)(Game *game)) {
 
 
@@ -195,14 +564,13 @@ static double simu_and_update(UctNode *root, Game *game,
 
   int index = 0;
   int i;
-  const char *key = NULL;
 
   /* stacks for updating the stats at the end of the current simulation */
-  static UctNode *node_stack[DEPTH_MAX];
-  static int action_stack[DEPTH_MAX];
-  static int score_stack[DEPTH_MAX];
-  static int alea_stack[DEPTH_MAX];
-  static UctNodeStats last_node_stats;
+  UctNode **node_stack = context->node_stack;
+  int *action_stack = context->action_stack;
+  int *score_stack = context->score_stack;
+  int *alea_stack = context->alea_stack;
+  UctNodeStats last_node_stats;
 
   /* simulates in the tree */
   while ((current_node != NULL) && (!game->game_over)) {
@@ -212,7 +580,7 @@ static double simu_and_update(UctNode *root, Game *game,
       }
 
       /* let's choose the action */
-      action_index = get_ucb_action(current_node, game);
+      action_index = get_ucb_action(context->table, current_node, game);
 
       /* for the forthcoming update, we store the visited nodes, actions  */
       node_stack[index] = current_node;
@@ -234,8 +602,7 @@ static double simu_and_update(UctNode *root, Game *game,
       index++;
 
       /* let's look for the future node */
-      key = compute_key(game);
-      current_node = (UctNode*) hashtable_get(hashtable, key);
+      current_node = uct_table_get(context->table, game);
   }
 
 
@@ -263,9 +630,10 @@ static double simu_and_update(UctNode *root, Game *game,
     last_node_stats=node_stack[i]->sons_stats[action_stack[i]][alea_stack[i]];
       
     if (last_node_stats.nb_simu >= NB_SIMU_BEFORE_CREATION-1) { /* do we create a new node ? (remark: we have not counted yet the last move) */
-      
-      current_node = uct_node_new(game, heuristic);
-      hashtable_add(hashtable, key, current_node); 
+      current_node = uct_table_add(context->table, game, heuristic); /* NULL if the table is full */
+    }
+
+    if (current_node != NULL) {
 
       /* printf("-> NewNode=%p ",(void*)current_node); */
      
@@ -294,7 +662,7 @@ static double simu_and_update(UctNode *root, Game *game,
 
 
 
-static int get_ucb_action(UctNode *father, Game *game) {
+static int get_ucb_action(UctTable *table, UctNode *father, Game *game) {
   
   /* the local variable stats will contain the sum of the stats for all the 7 possible next pieces/son */
 
@@ -338,7 +706,7 @@ static int get_ucb_action(UctNode *father, Game *game) {
 
       for (j = 0; j < NB_ALEA; j++) {  
 	game_set_current_piece_index(game, j);
-	cumulate_ucb_stats(father, game, i, j, &stats[i]);
+	cumulate_ucb_stats(table, father, game, i, j, &stats[i]);
       }
       total_trials += stats[i].nb_simu;
      
@@ -378,12 +746,12 @@ static int get_ucb_action(UctNode *father, Game *game) {
  * and the random outcome numero_random,
  * we add the sum_rewards and the number of trials to the uct_node_stats.
  */
-static void cumulate_ucb_stats(UctNode *father, Game *son, int num_action,
+static void cumulate_ucb_stats(UctTable *table, UctNode *father, Game *son, int num_action,
 			       int num_random, UctNodeStats *uct_node_stats) {
 
   UctNode *node;
 
-  node = hashtable_get(hashtable, compute_key(son));
+  node = uct_table_get(table, son);
 
   if (node != NULL) {
     uct_node_stats->nb_simu += node->stats.nb_simu;
@@ -405,18 +773,21 @@ static void cumulate_ucb_stats(UctNode *father, Game *son, int num_action,
   }
   }*/
 
-UctNode *uct_node_new(Game *game, double (*heuristic)(Game *game)) {
+/**
+ * Initializes a node with the possible actions of a game state,
+ * sorted by the heuristic.
+ */
+static void uct_node_init(UctNode *p, Game *game, double (*heuristic)(Game *game)) {
 
-  UctNode *p;
-  static double evaluations[MAX_ACTIONS];
-  static size_t sorted_indexes[MAX_ACTIONS];
-  static Action actions[MAX_ACTIONS];
+  double evaluations[MAX_ACTIONS];
+  size_t sorted_indexes[MAX_ACTIONS];
+  Action actions[MAX_ACTIONS];
 
   int i, j, k;
   int nb_possible_orientations, nb_possible_columns;
   Action action;
 
-  CALLOC(p, UctNode, 1);
+  memset(p, 0, sizeof(UctNode));
 
   k = 0;
 
@@ -448,13 +819,6 @@ UctNode *uct_node_new(Game *game, double (*heuristic)(Game *game)) {
     p->possible_actions[i] = actions[sorted_indexes[k - 1 - i]];
     /*    printf("(%i) %i %i %f  ",i,p->possible_actions[i].column,p->possible_actions[i].orientation,evaluations[sorted_indexes[k-1-i]]); */
   }
-
-  return p;
-}
-
-void uct_node_free(void *node) {
-
-  FREE(node);
 }
 
 
@@ -474,15 +838,10 @@ void uct_node_free(void *node) {
 /* } */
 
 
+/* the feature policy is loaded by main() before the threads start */
 static double heuristic(Game *game) {
 
-  static FeaturePolicy *feature_policy = NULL;
-
-  if (feature_policy == NULL) {
-    MALLOC(feature_policy, FeaturePolicy);
-    load_feature_policy("features/record_du.dat", feature_policy);
-  }
-  return evaluate_features(game, feature_policy);
+  return evaluate_features(game, heuristic_feature_policy);
 
 }
 
@@ -523,42 +882,50 @@ static double heuristic(Game *game) {
 
 
 
+/**
+ * Plays one game with UCT.
+ * Usage: ./uct [nb_threads]
+ * By default, one tree is developed per processor.
+ */
 int main(int argc, char **argv) {
 
   Game *game;
-  UctNode *root;
+  UctSearch *search;
   Action action;
+  unsigned long seed;
+  int nb_threads;
+
+  nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (argc >= 2) {
+    nb_threads = atoi(argv[1]);
+  }
+  if (nb_threads < 1) {
+    nb_threads = 1;
+  }
 
-  initialize_random_generator(time(NULL));
+  seed = time(NULL);
+  initialize_random_generator(seed);
   /*  initialize_random_generator(1); to make our bugs reproductible :) */
 
-  hashtable = hashtable_new(HASHTABLE_SIZE, uct_node_free); 
+  MALLOC(heuristic_feature_policy, FeaturePolicy);
+  load_feature_policy("features/record_du.dat", heuristic_feature_policy);
 
   /* Play one game */
 
   game = new_game(0, 10, 10, 0, "pieces4.dat", NULL);
 
-  root = uct_node_new(game, heuristic);
-  hashtable_add(hashtable, compute_key(game), root);
+  search = uct_search_new(game, nb_threads, UCT_MAX_NODES / nb_threads, seed);
   
   while (!game->game_over) {
-    action = think(root, game, 10, heuristic, heuristic);
+    action = think(search, game, 10, heuristic, heuristic);
     game_drop_piece(game, &action, 0);
     game_print(stdout, game);
     /*    getchar(); */
-
-    root = (UctNode*) hashtable_get(hashtable, compute_key(game));
-
-    if (root == NULL && !game->game_over) {  /* it might be that the new game state we get to was not created by UCT: this happens if random simulations never picked the right "next piece" */
-      root = uct_node_new(game, heuristic);
-      hashtable_add(hashtable, compute_key(game), root);
-    }
   }
   
+  uct_search_free(search);
   free_game(game);
   exit_random_generator();
 
-  hashtable_free(hashtable);
-
   return 0;
 }
@@ -9,29 +9,73 @@
 #include <time.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include "config.h"
 #include "simple_tetris.h"
+#include "local_value_function.h"
 #include "game.h"
 #include "interruptions.h"
 #include "macros.h"
 #include "random.h"
 #include "zlib.h"
 
+/**
+ * Type of the state values in memory. Compile with VALUE_ITERATION_FLOAT
+ * to store them as floats, which halves the memory needed.
+ * The value files always contain doubles.
+ */
+#ifdef VALUE_ITERATION_FLOAT
+typedef float StateValue;
+#else
+typedef double StateValue;
+#endif
+
 /**
  * The vector of state values.
  */
-static double *values;
+static StateValue *values;
 
 /**
  * The vector of state values at the previous step.
  */
-static double *previous_values;
+static StateValue *previous_values;
 
 
 /**
- * The policy in each state-piece pair (action = translation*4+orientation)
+ * The policy in each state-piece pair (action = translation*4+orientation),
+ * in one array: the action of state s with piece k is policy[s * nb_pieces + k].
+ */
+static char *policy; 
+
+/**
+ * If not NULL, the tables above are not allocated in memory but mapped from files
+ * whose names start with this prefix. The tables are then paged by the system
+ * and survive the process, but the values of the successors are read in no
+ * particular order: this is only efficient while the tables fit in the page cache,
+ * it does not make boards whose tables exceed the memory solvable.
  */
-static char **policy; 
+static const char *table_file_prefix = NULL;
+
+/**
+ * 1 to store only the canonical states (see get_canonical_state_code()):
+ * a state and its mirror image have the same value, so this halves the memory
+ * and the time of an iteration. Only possible with a symmetric set of pieces.
+ */
+static int use_symmetry = 1;
+
+/**
+ * Number of states in the tables: NB_STATES, or the number of canonical states
+ * with the symmetry.
+ */
+static uint32_t nb_table_states;
+
+/**
+ * Number of states converted at once when the values are saved or read.
+ */
+#define STATES_PER_BLOCK 65536
 
 /**
  * The game.
@@ -40,6 +84,35 @@ static Game *game;
 
 static ValueIterationParameters parameters;
 
+/**
+ * Number of threads sharing the states of each iteration.
+ */
+static int nb_threads = 1;
+
+/**
+ * Number of consecutive states a thread takes at once.
+ */
+#define STATES_PER_CHUNK 4096
+
+/**
+ * Next state to be updated in the current iteration, shared by the threads.
+ */
+static uint32_t next_state;
+
+/**
+ * A thread of the value iteration and what it computed in the current iteration.
+ */
+typedef struct ValueIterationWorker {
+  pthread_t thread;
+  Game *game;              /* each thread plays on its own board */
+  double delta;            /* maximum change of a state's value */
+  int nb_changed_actions;  /* number of actions that changed */
+} ValueIterationWorker;
+
+static void *allocate_table(const char *suffix, size_t size, int advice);
+static void free_table(void *table, size_t size);
+static void initialize_symmetry(void);
+static void allocate_tables(void);
 static void value_iteration_initialise(void);
 static void value_iteration(const char *value_file_name);
 static void value_iteration_exit(void);
@@ -52,7 +125,7 @@ static void read_values(gzFile *value_file);
 static void value_iteration_initialise() {
   char *line;
   size_t n, read;
-  int piece_set_number,i;
+  int piece_set_number;
   FILE *delta_file;
   char c;
 
@@ -145,19 +218,107 @@ static void value_iteration_initialise() {
   game = new_game(0, WIDTH, HEIGHT, 0, parameters.piece_file_name, NULL);
   parameters.nb_pieces = game->piece_configuration->nb_pieces;
 
-  /* Allocate the values */
-  CALLOC(values, double, NB_STATES);
+  /* Allocate the values and the policy */
+  initialize_symmetry();
+  allocate_tables();
+}
 
-  if (parameters.use_buffer) {
-    CALLOC(previous_values, double, NB_STATES);
+/**
+ * Checks that the set of pieces is symmetric before using the symmetry of the states,
+ * and numbers the canonical states.
+ *
+ * The pieces are drawn uniformly, so with a set closed under mirroring,
+ * a state and its mirror image have the same value: the backup of a canonical
+ * state simulates this state itself with the pieces of the set, and only looks
+ * up the values of its successors by their canonical state. No permutation
+ * of the pieces is needed, but this holds only for a symmetric set.
+ */
+static void initialize_symmetry() {
+
+  if (use_symmetry && !pieces_are_symmetric(game->piece_configuration)) {
+    printf("The set of pieces is not symmetric: all states are stored\n");
+    use_symmetry = 0;
   }
 
-  /* Allocate the policy */
-  CALLOC(policy, char*, NB_STATES);
-  for (i=0; i<NB_STATES; i++) {
-    CALLOC(policy[i],char,parameters.nb_pieces);
+  nb_table_states = NB_STATES;
+  if (use_symmetry) {
+    initialize_canonical_states();
+    nb_table_states = get_nb_canonical_states();
   }
+}
 
+/**
+ * Returns the index of a state in the tables.
+ */
+static inline uint32_t get_state_index(uint32_t s) {
+
+  if (use_symmetry) {
+    return get_canonical_state_rank(get_canonical_state_code(s));
+  }
+  return s;
+}
+
+/**
+ * Allocates a table initialized to zero, in memory or in a file
+ * mapped in memory if table_file_prefix is set. The access pattern
+ * (MADV_RANDOM or MADV_SEQUENTIAL) tells the kernel how to page a mapped table.
+ */
+static void *allocate_table(const char *suffix, size_t size, int advice) {
+  char file_name[MAX_FILE_NAME + 16];
+  void *table;
+  int fd, length;
+
+  if (table_file_prefix == NULL) {
+    CALLOC(table, char, size);
+    return table;
+  }
+
+  length = snprintf(file_name, sizeof(file_name), "%s.%s", table_file_prefix, suffix);
+  if (length < 0 || length >= (int) sizeof(file_name)) {
+    DIE1("The table file names of '%s' are too long", table_file_prefix);
+  }
+  fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1 || ftruncate(fd, size) != 0) {
+    DIE1("Cannot create the table file '%s'", file_name);
+  }
+  table = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (table == MAP_FAILED) {
+    DIE1("Cannot map the table file '%s'", file_name);
+  }
+  madvise(table, size, advice);
+
+  return table;
+}
+
+/**
+ * Frees a table allocated by allocate_table().
+ */
+static void free_table(void *table, size_t size) {
+
+  if (table_file_prefix == NULL) {
+    FREE(table);
+  }
+  else {
+    munmap(table, size);
+  }
+}
+
+/**
+ * Allocates the values, the previous values if a buffer is used, and the policy.
+ */
+static void allocate_tables() {
+
+  /* the values of the successors are read in no particular order */
+  values = (StateValue*) allocate_table("values", sizeof(StateValue) * nb_table_states, MADV_RANDOM);
+
+  if (parameters.use_buffer) {
+    previous_values = (StateValue*) allocate_table("previous_values", sizeof(StateValue) * nb_table_states,
+						   MADV_RANDOM);
+  }
+
+  /* the policy of a state is only read and written when the state is updated */
+  policy = (char*) allocate_table("policy", (size_t) nb_table_states * parameters.nb_pieces, MADV_SEQUENTIAL);
 }
 
 /**
@@ -165,24 +326,34 @@ static void value_iteration_initialise() {
  */
 static void value_iteration_exit() {
 
-  FREE(values);
+  free_table(values, sizeof(StateValue) * nb_table_states);
   if (parameters.use_buffer) {
-    FREE(previous_values);
+    free_table(previous_values, sizeof(StateValue) * nb_table_states);
   }
+  free_table(policy, (size_t) nb_table_states * parameters.nb_pieces);
   free_game(game);
-
+  if (use_symmetry) {
+    exit_canonical_states();
+  }
 }
 
 /**
- * Executes the algorithm Value Iteration.
+ * Updates the value of a state and its best action for each piece.
+ * With the buffer (Jacobi iteration), the values of the previous iteration are read
+ * and the new value is written into another array. Without it (Gauss-Seidel iteration),
+ * both arrays are the same and the threads read and write the values in place:
+ * each value is loaded and stored atomically, so a thread sees either the old or the
+ * new value of a state updated by another thread.
+ * With the symmetry, s is a canonical state and the successors are replaced
+ * by their canonical states.
+ * Returns the change of the value of the state.
  */
-static void value_iteration(const char *value_file_name) {
-  /* the state */
-  uint32_t s;               /* current state */
-  double v;                 /* current value of state s, taking action (i,j) */
+static double update_state(Game *game, uint32_t s, uint32_t index, int *nb_changed_actions) {
+  StateValue stored_value;  /* a value as stored in the tables */
+  double v;                 /* current value of state s */
+  double new_value;         /* new value of state s */
+  double next_value;        /* value of the state reached by action (i,j) */
   int nb_pieces;            /* number of possible pieces */
-
-  /* the action: a couple (orientation, column) */
   int nb_possible_columns, nb_possible_orientations;
   int i;                    /* orientation of the falling piece */
   int j;                    /* column of the falling piece */
@@ -191,20 +362,124 @@ static void value_iteration(const char *value_file_name) {
   int k;                    /* number of a possible next falling piece after s */
   uint32_t s2;              /* one possible state after s, taking action (i,j) */
   int reward;               /* immediate reward when taking action (i,j) in state s */
+  char best_action_code;    /* best_action_code = 4*column + orientation */
+  char *state_policy;       /* the best actions of state s */
+  Board *board;
+  PieceOrientation *orientations;
+
+  board = game->board;
+  nb_pieces = parameters.nb_pieces;
+  best_action_code = 0;
+  s2 = 0;
+
+  set_game_state(game, s);
+  __atomic_load(&previous_values[index], &stored_value, __ATOMIC_RELAXED);
+  v = stored_value; /* current value of the state */
+  state_policy = &policy[(size_t) index * nb_pieces];
+
+  /* We have to make a sum of values for each possible current piece in state s */
+  new_value = 0;
+  for (k = 0; k < nb_pieces; k++) { /* consider each possible piece */
+    game_set_current_piece_index(game, k);
+
+    /* Now we are in state s with piece k as current piece.
+     * We try every action and keep the best one's value.
+     */
+    best_action_value = -1;
+    orientations = game->current_piece->orientations;
+    nb_possible_orientations = game_get_nb_possible_orientations(game);
+
+    for (i = 0; i < nb_possible_orientations; i++) {
+      nb_possible_columns = game_get_nb_possible_columns(game, i);
+      for (j = 1; j <= nb_possible_columns; j++) {
+
+	/* At this point we have selected an action.
+	 * Now we play this action to evaluate it.
+	 */
+	reward = board_drop_piece(board, &orientations[i], i, j, NULL, 1); /* immediate reward */
+	if (board->wall_height > board->height) {
+	  reward = -1;
+	} else {
+	  s2 = get_game_code(game); /* get the id of the resulting state */
+	}
+	board_cancel_last_move(board); /* restore the board */
+
+	action_value = 0; /* value of the action we made */
+	if (reward != -1) { /* not game over */
+	  __atomic_load(&previous_values[get_state_index(s2)], &stored_value, __ATOMIC_RELAXED);
+	  next_value = stored_value;
+	  action_value = reward + parameters.gamma * next_value;
+	}
+
+	/* if we found a better value for this action, keep it */
+	if (action_value > best_action_value) {
+	  best_action_value = action_value;
+	  best_action_code = 4*j+i;
+	}
+      }
+    }
+    new_value += best_action_value;
+
+    if (state_policy[k] != best_action_code) {
+      (*nb_changed_actions)++;
+      state_policy[k] = best_action_code;
+    }
+  }
+  new_value /= nb_pieces; /* normalization */
+  stored_value = new_value;
+  __atomic_store(&values[index], &stored_value, __ATOMIC_RELAXED);
+
+  return fabs(v - stored_value);
+}
+
+/**
+ * Main function of a thread: updates chunks of states until all states
+ * of the current iteration are done.
+ */
+static void *value_iteration_worker(void *arg) {
+  ValueIterationWorker *worker = (ValueIterationWorker*) arg;
+  uint32_t first, last, s;
+  double value_change;
+
+  worker->delta = 0;
+  worker->nb_changed_actions = 0;
+
+  while ((first = __atomic_fetch_add(&next_state, STATES_PER_CHUNK, __ATOMIC_RELAXED)) < NB_STATES) {
+    last = MIN(first + STATES_PER_CHUNK, NB_STATES);
+    for (s = first; s < last; s++) {
+      if (use_symmetry && get_canonical_state_code(s) != s) {
+	continue; /* same value as its mirror image */
+      }
+      value_change = update_state(worker->game, s, get_state_index(s), &worker->nb_changed_actions);
+      worker->delta = MAX(worker->delta, value_change);
+    }
 
+    if (first % 1048576 == 0) { /* just to print the progression */
+      printf("  state %d\r", first);
+      fflush(stdout);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Executes the algorithm Value Iteration.
+ * The states are shared between nb_threads threads.
+ */
+static void value_iteration(const char *value_file_name) {
   /* algorithm convergence */
-  double gamma;             /* discount factor */
   int iterations;           /* number of iterations */
   double delta;             /* maximum change of a state's value during an iteration */
   double delta_limit;       /* limit of delta to stop the algorithm */
-  double value_change;      /* change of a state's value during an iteration */
   FILE *delta_file;         /* file to save the value of delta at each iteration */
-  double *tmp_values;       /* variable to swap the buffers */
-  char best_action_code;    /* best_action_code = 4*column + orientation */
+  StateValue *tmp_values;   /* variable to swap the buffers */
   int nb_changed_actions;   /* count the number of actions that change from one iteration to the next */
 
-  Board *board;
-  PieceOrientation *orientations;
+  ValueIterationWorker *workers;
+  struct timespec start, end;
+  double elapsed;
+  int t;
 
   char file_name[256];
 
@@ -214,9 +489,6 @@ static void value_iteration(const char *value_file_name) {
   /* start Value Iteration */
   delta_file = fopen(parameters.delta_file_name, "a");
 
-  board = game->board;
-  nb_pieces = parameters.nb_pieces;
-  gamma = parameters.gamma;
   delta_limit = parameters.delta_limit;
   iterations = parameters.iterations;
 
@@ -225,87 +497,38 @@ static void value_iteration(const char *value_file_name) {
     previous_values = values;
   }
 
-  do {
-    delta = 0;
-    
-    nb_changed_actions=0;
-    best_action_code=0;
-
-    /* visit each state to update its value */
-    for (s = 0; s < NB_STATES; s++) { 
-      set_game_state(game, s);
-      v = previous_values[s]; /* current value of the state */
-
-/*       if (s == 0) { */
-/* 	printf("--------------\nevaluating state %d\n", s); */
-/* 	game_print(stdout, game); */
-/* 	printf("current value of this state: %f\n", v); */
-/*       } */
-
-      /* We have to make a sum of values for each possible current piece in state s */
-      values[s] = 0;
-      for (k = 0; k < nb_pieces; k++) { /* consider each possible piece */
-	game_set_current_piece_index(game, k);
-/* 	if (s == 0) printf("current piece: %d\n", k); */
-
-	/* Now we are in state s with piece k as current piece.
-	 * We try every action and keep the best one's value.
-	 */
-
-	best_action_value = -1;
-	orientations = game->current_piece->orientations;
-	nb_possible_orientations = game_get_nb_possible_orientations(game);
-
-	for (i = 0; i < nb_possible_orientations; i++) {
-	  nb_possible_columns = game_get_nb_possible_columns(game, i);
-	  for (j = 1; j <= nb_possible_columns; j++) {
-/* 	    if (s == 0) printf("Action: orientation %d, column %d\n", i, j); */
-	    
-	    /* At this point we have selected an action.
-	     * Now we play this action to evaluate it.
-	     */
-	    reward = board_drop_piece(board, &orientations[i], i, j, NULL, 1); /* immediate reward */	    
-	    if (game->board->wall_height > game->board->height) {
-	      reward=-1;
-	    } else {
-	      s2 = get_game_code(game); /* get the id of the resulting state */
-	    }
-	    board_cancel_last_move(board); /* restore the board */
-	    
-	    action_value = 0; /* value of the action we made */
-	    if (reward != -1) { /* not game over */	      
-	      action_value = reward + gamma * previous_values[s2];
-	    }
-/* 	    if (s == 0) printf("in state %d: reward = %d, new action value = %f\n", s2, reward, action_value); */
-
-	    /* if we found a better value for this action, keep it */
-	    if (action_value>best_action_value) {
-	      best_action_value = action_value;
-	      best_action_code = 4*j+i;
-	    }
-	  }
-	}	
-	values[s] += best_action_value;
-
-	if (policy[s][k] != best_action_code) {
-	  nb_changed_actions++;
-	  policy[s][k]=best_action_code;
-	}
-
+  /* one board per thread (created here because new_game uses the global random generator) */
+  MALLOCN(workers, ValueIterationWorker, nb_threads);
+  workers[0].game = game;
+  for (t = 1; t < nb_threads; t++) {
+    workers[t].game = new_game_copy(game);
+  }
 
-/* 	if (s == 0) printf("value of this state with piece %d: %f\n", k, best_action_value); */
-      }
-/*       if (s == 0) printf("total value of this state: %f\n", values[s]); */
-      values[s] /= nb_pieces; /* normalization */
+  printf("Value iteration with %d thread(s), %s, %u states stored\n", nb_threads,
+	 parameters.use_buffer ? "Jacobi (buffered)" : "Gauss-Seidel (in place)", nb_table_states);
 
-      value_change = fabs(v - values[s]);
-      delta = MAX(delta, value_change);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-      if (s % 100000 == 0) { /* just to print the progression */
-	printf("  state %d\r", s);
-	fflush(stdout);
+    /* visit each state to update its value */
+    next_state = 0;
+    for (t = 1; t < nb_threads; t++) {
+      if (pthread_create(&workers[t].thread, NULL, value_iteration_worker, &workers[t]) != 0) {
+	DIE("Cannot create a thread");
       }
     }
+    value_iteration_worker(&workers[0]);
+
+    delta = workers[0].delta;
+    nb_changed_actions = workers[0].nb_changed_actions;
+    for (t = 1; t < nb_threads; t++) {
+      pthread_join(workers[t].thread, NULL);
+      delta = MAX(delta, workers[t].delta);
+      nb_changed_actions += workers[t].nb_changed_actions;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
 
     if (parameters.use_buffer) {
       tmp_values = previous_values;
@@ -313,7 +536,8 @@ static void value_iteration(const char *value_file_name) {
       values = tmp_values;
     }
 
-    printf("%d iteration(s), delta v = %e, delta pi = %d\n", ++iterations, delta, nb_changed_actions);
+    printf("%d iteration(s), delta v = %e, delta pi = %d, %.0f states/s\n", ++iterations, delta, nb_changed_actions,
+	   nb_table_states / elapsed);
     fprintf(delta_file, "%d %e %d\n", iterations, delta,nb_changed_actions);
     fflush(delta_file);
 
@@ -326,6 +550,11 @@ static void value_iteration(const char *value_file_name) {
   } while (delta > delta_limit && !is_interrupted());
   fclose(delta_file);
 
+  for (t = 1; t < nb_threads; t++) {
+    free_game(workers[t].game);
+  }
+  FREE(workers);
+
   /* save the values */
   parameters.iterations = iterations;
   save_values(value_file_name);
@@ -336,11 +565,20 @@ static void value_iteration(const char *value_file_name) {
  */
 static void save_values(const char *value_file_name) {
   gzFile *value_file;
+  double block[STATES_PER_BLOCK];
+  int first, i;
 
   printf("Saving the state values into the file %s... ",value_file_name);
   value_file = gzopen(value_file_name, "w");
   gzwrite(value_file, &parameters, sizeof(ValueIterationParameters));
-  gzwrite(value_file, values, sizeof(double)*NB_STATES);
+
+  /* the file contains doubles for all states, whatever the type of the values in memory */
+  for (first = 0; first < NB_STATES; first += STATES_PER_BLOCK) {
+    for (i = 0; i < STATES_PER_BLOCK; i++) {
+      block[i] = values[get_state_index(first + i)];
+    }
+    gzwrite(value_file, block, sizeof(block));
+  }
 
   /*if (parameters.use_buffer) {
     fwrite(previous_values, sizeof(double), NB_STATES, value_file);
@@ -355,19 +593,26 @@ static void save_values(const char *value_file_name) {
  * from a file.
  */
 static void read_values(gzFile *value_file) {
+  StateValue *read;
+  double block[STATES_PER_BLOCK];
+  int first, i;
 
   gzread(value_file, &parameters, sizeof(ValueIterationParameters));
 
-  MALLOCN(values, double, NB_STATES);
+  game = new_game(0, WIDTH, HEIGHT, 0, parameters.piece_file_name, NULL);
 
-  if (parameters.use_buffer == 1) {
-    MALLOCN(previous_values, double, NB_STATES);
-    gzread(value_file, previous_values, sizeof(double)*NB_STATES);
-  } else {
-    gzread(value_file, values, sizeof(double)*NB_STATES);
-  }
+  initialize_symmetry();
+  allocate_tables();
 
-  game = new_game(0, WIDTH, HEIGHT, 0, parameters.piece_file_name, NULL);
+  read = (parameters.use_buffer == 1) ? previous_values : values;
+  for (first = 0; first < NB_STATES; first += STATES_PER_BLOCK) {
+    gzread(value_file, block, sizeof(block));
+    for (i = 0; i < STATES_PER_BLOCK; i++) {
+      if (!use_symmetry || get_canonical_state_code(first + i) == (uint32_t) (first + i)) {
+	read[get_state_index(first + i)] = block[i];
+      }
+    }
+  }
 
   printf("Resuming value iteration with the following parameters:\n");
   printf("nb_pieces: %d, use_buffer: %d, delta_limit: %f, iterations: %d, piece_file_name: %s, delta_file_name: %s\n",
@@ -375,20 +620,106 @@ static void read_values(gzFile *value_file) {
 	 parameters.piece_file_name, parameters.delta_file_name);
 }
 
+/**
+ * Writes the state values of a value file into a mapped values file,
+ * which feature NEXT_LOCAL_VALUE_FUNCTION can share between processes.
+ * With a symmetric set of pieces, only the canonical states are written.
+ */
+static void export_mapped_values(const char *value_file_name, const char *mapped_file_name, int use_float) {
+  gzFile value_file;
+  double *exported_values;
+
+  value_file = gzopen(value_file_name, "r");
+  if (value_file == NULL) {
+    DIE1("Unable to open the value file '%s'", value_file_name);
+  }
+
+  gzread(value_file, &parameters, sizeof(ValueIterationParameters));
+  MALLOCN(exported_values, double, NB_STATES);
+  if (gzread(value_file, exported_values, sizeof(double)*NB_STATES) != sizeof(double)*NB_STATES) {
+    DIE1("The value file '%s' is incomplete", value_file_name);
+  }
+  gzclose(value_file);
+
+  game = new_game(0, WIDTH, HEIGHT, 0, parameters.piece_file_name, NULL);
+  initialize_symmetry();
+  free_game(game);
+  if (use_symmetry) {
+    exit_canonical_states();
+  }
+
+  printf("Saving the state values into the file %s... ", mapped_file_name);
+  save_mapped_local_value_function(mapped_file_name, exported_values, use_float, use_symmetry);
+  printf("Done.\n");
+
+  FREE(exported_values);
+}
+
 /**
  * Main function.
- * Usage: ./value_iteration value_file_name
+ * Usage: ./value_iteration [-threads nb_threads] [-mapped] [-nosymmetry] value_file_name
+ *    or: ./value_iteration [-nosymmetry] value_file_name mapped_file_name [float]
+ * By default, the value iteration uses one thread per processor, and stores only one
+ * state of each pair of mirror images if the set of pieces is symmetric.
+ * With -mapped, the values and the policy are kept in files mapped in memory
+ * (value_file_name.values, .previous_values and .policy) instead of in anonymous
+ * memory; they must still fit in the page cache (see table_file_prefix).
+ * The second form exports the values to a mapped values file (see local_value_function.h),
+ * as floats if the third argument is "float".
  */
 int main(int argc, char **argv) {
   gzFile *value_file;
 
-  if (argc != 2) {
-    fprintf(stderr, "Usage: %s value_file_name\n", argv[0]);
+  int mapped_tables;
+
+  nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  mapped_tables = 0;
+  while (argc >= 2 && argv[1][0] == '-') {
+    if (argc >= 3 && strcmp(argv[1], "-threads") == 0) {
+      nb_threads = atoi(argv[2]);
+      argv[2] = argv[0];
+      argc -= 2;
+      argv += 2;
+    }
+    else if (strcmp(argv[1], "-mapped") == 0) {
+      mapped_tables = 1;
+      argv[1] = argv[0];
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-nosymmetry") == 0) {
+      use_symmetry = 0;
+      argv[1] = argv[0];
+      argc--;
+      argv++;
+    }
+    else {
+      break;
+    }
+  }
+  if (nb_threads < 1) {
+    nb_threads = 1;
+  }
+
+  if (argc < 2 || argc > 4 || (argc == 4 && strcmp(argv[3], "float") != 0)) {
+    fprintf(stderr, "Usage: %s [-threads nb_threads] [-mapped] [-nosymmetry] value_file_name [mapped_file_name [float]]\n", argv[0]);
     exit(1);
   }
-  
+
+  /* the tables are mapped from files named after the value file */
+  if (mapped_tables) {
+    table_file_prefix = argv[1];
+  }
+
+  /* new_game() chooses the first piece randomly */
   initialize_random_generator(time(NULL));
 
+  if (argc >= 3) {
+    export_mapped_values(argv[1], argv[2], argc == 4);
+    exit_random_generator();
+    return 0;
+  }
+
   value_file = gzopen(argv[1], "r");
   if (value_file == NULL) {
     /* new instance of value iteration */
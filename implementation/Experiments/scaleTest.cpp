@@ -65,6 +65,10 @@ int main()
 
     MDPTetris objFun(10,20, nbGames, game, stats, start_policy );
 
+    /* Every scaled vector plays the same games */
+    objFun.setRunSeed(seed);
+    objFun.setSeedPerCandidate(false);
+
     shark::RealVector test_vector(objFun.numberOfVariables());
 
     double arr[] = {-4.49139,-6.73538,-10.8526,-9.02891,-10.4329,-11.5992,
@@ -82,7 +86,6 @@ int main()
         {
             scaled(j) = test_vector(j) * i;
         }
-        initialize_random_generator( seed );
         std::cout << i << "," << TETRIS_MAX_SCORE - objFun.eval(scaled) << std::endl;
     }
 
@@ -0,0 +1,53 @@
+//
+// Converts a binary run trace (-outputFormat=binary) to the CSV
+// written by default, so that the plotting scripts can read it.
+//
+// Usage: TraceToCsv trace.bin [output.txt]
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "RunTrace.h"
+
+int main( int argc, char ** argv )
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " trace.bin [output.txt]" << std::endl;
+        return 64;
+    }
+
+    RunTraceReader trace(argv[1]);
+
+    std::ofstream file;
+    if (argc == 3)
+    {
+        file.open(argv[2]);
+        if (!file)
+        {
+            std::cerr << "Cannot write " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = (argc == 3) ? file : std::cout;
+
+    const std::vector<std::string> &columns = trace.columns();
+    for (std::size_t i = 0; i < columns.size(); i++)
+    {
+        out << (i == 0 ? "" : ",") << columns[i];
+    }
+    out << std::endl;
+
+    for (std::size_t r = 0; r < trace.nbRecords(); r++)
+    {
+        for (std::size_t i = 0; i < columns.size(); i++)
+        {
+            out << (i == 0 ? "" : ",") << csvField(trace.value(r, i));
+        }
+        out << '\n';
+    }
+
+    return 0;
+}